@@ -0,0 +1,205 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/sleep.h>
+
+#include <stdint.h>
+#include <stdbool.h>
+#include <stdio.h>
+
+#include "lib/iopins.h"
+#include "lib/usart.h"
+#include "lib/mbuf.h"
+#include "lib/median.h"
+#include "lib/track.h"
+#include "lib/debounce.h"
+#include "pipeline.h"
+#include "ws2812.h"
+#include "gamma.h"
+#include "float_ref.h"
+
+//
+// Firmware microbenchmarks, run under simavr by `make bench`.
+//
+// Timer1 runs at F_CPU, each benchmark is timed BENCH_REPEAT times with
+// interrupts disabled and the mean number of cycles per call is printed:
+//
+//   BENCH <name> <cycles> <budget> <ok|FAIL|ref>
+//   ...
+//   BENCH_END <number of failures>
+//
+// The budgets are the maximum allowed cycles - raise them only together
+// with the change that made the code slower. Reference code kept only
+// for comparison (budget 0) is reported as "ref" and never fails.
+//
+
+#define BENCH_REPEAT 16
+
+/** Number of LEDs in the strip benchmark */
+#define BENCH_LEDS 30
+
+/**
+ * Cycle budgets
+ *
+ * These were set by hand, not taken from a simavr run yet, so
+ * `make bench` doesn't fail on them (BENCH_STRICT in the Makefile).
+ * `make bench-calibrate` prints the measured cycles plus 25 % -
+ * replace the values below with those and set BENCH_STRICT to 1.
+ */
+#define BUDGET_MBUF_ADD     150
+#define BUDGET_PIPE_CONVERT 250
+#define BUDGET_PIPE_PROCESS 400
+#define BUDGET_WS_FRAME     17000
+#define BUDGET_DEBO_TICK_1  150
+#define BUDGET_DEBO_TICK_8  150
+#define BUDGET_DEBO_TICK    300
+#define BUDGET_PIN_N        60
+#define BUDGET_PIN_H        20
+#define BUDGET_GAMMA        25
+#define BUDGET_MEDIAN_5     200
+#define BUDGET_MEDIAN_7     250
+#define BUDGET_MEDIAN_9     300
+#define BUDGET_HAMPEL_9     450
+#define BUDGET_TRACK        250
+
+/** Cycles taken by the measurement itself */
+static uint16_t bench_overhead = 0;
+
+static uint8_t bench_failed = 0;
+
+/** Values the compiler can't see through */
+static volatile uint8_t v_pin = 13;
+static volatile uint16_t v_echo = 4321;
+static volatile uint8_t v_sink;
+
+/** Handle of v_pin (the pointer is volatile, so it's loaded every time) */
+static PinHandle h_pin;
+static PinHandle * volatile v_hpin = &h_pin;
+
+MBUF_DEFINE(mb_bench, 16);
+MEDBUF_DEFINE(md_bench5, 5);
+MEDBUF_DEFINE(md_bench7, 7);
+MEDBUF_DEFINE(md_bench9, 9);
+MEDBUF_DEFINE(md_hampel9, 9);
+static Track tr_bench;
+
+
+/** Print one result line */
+static void bench_report(const char *name_P, uint16_t cycles, uint16_t budget)
+{
+	char buf[64];
+	bool ok = cycles <= budget;
+
+	if (!ok && budget != 0) {
+		bench_failed++;
+	}
+
+	sprintf_P(buf, PSTR("BENCH %S %u %u %S\n"), name_P, cycles, budget,
+	          budget == 0 ? PSTR("ref") : ok ? PSTR("ok") : PSTR("FAIL"));
+	usart_puts(buf);
+}
+
+
+/** Time `stmt`, report the mean cycles per run */
+#define BENCH(name, budget, stmt) \
+	do { \
+		uint32_t _sum = 0; \
+		for (uint8_t _i = 0; _i < BENCH_REPEAT; _i++) { \
+			cli(); \
+			uint16_t _t0 = TCNT1; \
+			stmt; \
+			uint16_t _t1 = TCNT1; \
+			sei(); \
+			_sum += (uint16_t)(_t1 - _t0 - bench_overhead); \
+		} \
+		bench_report(PSTR(name), (uint16_t)(_sum / BENCH_REPEAT), (budget)); \
+	} while (0)
+
+
+/** Send one frame to the strip */
+static void ws_frame(void)
+{
+	for (uint8_t i = 0; i < BENCH_LEDS; i++) {
+		ws_send_rgb(i, (uint8_t)(i * 2), (uint8_t)(i * 3));
+	}
+}
+
+
+int main(void)
+{
+	usart_init(BAUD_115200);
+	ws_init();
+
+	// Timer1 at F_CPU
+	TCCR1A = 0;
+	TCCR1B = (0b001 << CS10);
+
+	// measure the overhead of an empty benchmark
+	{
+		cli();
+		uint16_t t0 = TCNT1;
+		uint16_t t1 = TCNT1;
+		bench_overhead = t1 - t0;
+	}
+
+	sei();
+
+	BENCH("mbuf_add", BUDGET_MBUF_ADD, mbuf_add(&mb_bench, v_echo));
+	BENCH("pipe_convert", BUDGET_PIPE_CONVERT, v_sink = (uint8_t) pipe_convert(0, v_echo));
+	BENCH("pipe_process", BUDGET_PIPE_PROCESS, v_sink = pipe_process(0, v_echo));
+	BENCH("pipe_float_ref", 0, v_sink = float_ref_process(v_echo));
+	BENCH("ws_frame_30", BUDGET_WS_FRAME, ws_frame());
+	BENCH("gamma_apply", BUDGET_GAMMA, v_sink = gamma_apply(v_sink, GAMMA_ROUND));
+
+	// the input keeps changing, so the samples move around in the sorted window
+	BENCH("median_5", BUDGET_MEDIAN_5, medbuf_add(&md_bench5, v_echo += 4099));
+	BENCH("median_7", BUDGET_MEDIAN_7, medbuf_add(&md_bench7, v_echo += 4099));
+	BENCH("median_9", BUDGET_MEDIAN_9, medbuf_add(&md_bench9, v_echo += 4099));
+	BENCH("hampel_9", BUDGET_HAMPEL_9, medbuf_hampel(&md_hampel9, v_echo += 4099, MEDBUF_HAMPEL_K(3), 2048));
+
+	BENCH("track", BUDGET_TRACK, {
+		track_update(&tr_bench, v_echo += 4099, TRACK_COEF(0.4), TRACK_COEF(0.1));
+		v_echo = track_predict(&tr_bench, 256);
+	});
+
+	// debouncer channels - the pins are only read: a whole port first
+	// (D0..D7, so debo_tick_8 is one port like debo_tick_1), then A0..A2
+	for (uint8_t i = 0; i < DEBO_CHANNELS; i++) {
+		if (i < 8) {
+			debo_add_do(&PIND, i, i & 1, NULL);
+		} else {
+			debo_add_do(&PINC, (uint8_t)(i - 8), i & 1, NULL);
+		}
+
+		if (i == 0) {
+			BENCH("debo_tick_1", BUDGET_DEBO_TICK_1, debo_tick());
+		} else if (i == 7) {
+			BENCH("debo_tick_8", BUDGET_DEBO_TICK_8, debo_tick());
+		}
+	}
+	BENCH("debo_tick_all", BUDGET_DEBO_TICK, debo_tick());
+	BENCH("pin_up_n", BUDGET_PIN_N, pin_up_n(v_pin));
+	BENCH("pin_down_n", BUDGET_PIN_N, pin_down_n(v_pin));
+	BENCH("pin_toggle_n", BUDGET_PIN_N, pin_toggle_n(v_pin));
+	BENCH("pin_read_n", BUDGET_PIN_N, v_sink = pin_read_n(v_pin));
+	BENCH("pin_is_high_n", BUDGET_PIN_N, v_sink = pin_is_high_n(v_pin));
+
+	h_pin = pin_handle(v_pin);
+	BENCH("pin_up_h", BUDGET_PIN_H, pin_up_h(v_hpin));
+	BENCH("pin_down_h", BUDGET_PIN_H, pin_down_h(v_hpin));
+	BENCH("pin_toggle_h", BUDGET_PIN_H, pin_toggle_h(v_hpin));
+	BENCH("pin_read_h", BUDGET_PIN_H, v_sink = pin_read_h(v_hpin));
+
+	char buf[20];
+	sprintf_P(buf, PSTR("BENCH_END %u\n"), bench_failed);
+	usart_puts(buf);
+	usart_flush_tx();
+
+	// wait for the last byte, then stop (simavr exits on sleep with interrupts off)
+	while (bit_is_low(UCSR0A, TXC0));
+	cli();
+	sleep_enable();
+	sleep_cpu();
+
+	return 0;
+}
@@ -0,0 +1,24 @@
+#include <stdint.h>
+
+#include "pipeline.h"
+#include "float_ref.h"
+
+//
+// Smallest program around one echo conversion, for comparing the flash
+// taken by the fixed-point pipeline and the old float version
+// (`make bench-size` builds it both ways).
+//
+
+static volatile uint16_t v_echo = 4321;
+static volatile uint8_t v_sink;
+
+int main(void)
+{
+	for (;;) {
+#ifdef CONV_FLOAT
+		v_sink = float_ref_process(v_echo);
+#else
+		v_sink = pipe_process(0, v_echo);
+#endif
+	}
+}
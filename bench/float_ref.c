@@ -0,0 +1,45 @@
+#include <math.h>
+#include <stdint.h>
+
+#include "float_ref.h"
+
+/** averaging buffer length (number of samples) */
+#define MBUF_LEN 16
+
+static float data[MBUF_LEN];
+
+
+/** Add a value to the averaging buffer. Returns currrent mean value */
+static float mbuf_add(float value)
+{
+	float aggr = value;
+	for (int i = MBUF_LEN - 1; i > 0; i--) {
+		float m = data[i - 1];
+		aggr += m;
+		data[i] = m;
+	}
+
+	data[0] = value;
+
+	return aggr / (float)MBUF_LEN;
+}
+
+
+/** Process a measured echo width, float version of pipe_process() with sensitivity 25 */
+uint8_t float_ref_process(uint16_t echo)
+{
+	// The number '25.0f' here determines the sensitivity
+	float offset = 255 - echo / (1.25f * 25.0f);
+
+	if (offset > 255) {
+		offset = 255;
+	} else if (offset < 0) {
+		offset = 0;
+	}
+
+	// averaging
+	offset = mbuf_add(offset);
+
+	// to int
+	return (uint8_t) roundf(offset);
+}
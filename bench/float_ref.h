@@ -0,0 +1,12 @@
+#pragma once
+
+//
+// The echo-to-color conversion as it was before the fixed point
+// (soft-float, 16 sample float moving average, roundf) - kept only
+// for comparing cycles and flash in `make bench` / `make bench-size`.
+//
+
+#include <stdint.h>
+
+/** Process a measured echo width, float version of pipe_process() with sensitivity 25 */
+uint8_t float_ref_process(uint16_t echo);
@@ -0,0 +1,52 @@
+# Turns the `make bench` simavr output into a table (tab separated),
+# exits with 1 if a budget was exceeded or the run didn't finish.
+#
+# Going over a budget only fails with -v strict=1 (BENCH_STRICT in the
+# Makefile) - without it, the run is reported but passes.
+#
+# With -v calibrate=1 (`make bench-calibrate`), it doesn't fail on the
+# budgets and suggests new ones instead: the cycles plus 25 %, rounded
+# up to 10.
+
+BEGIN {
+	OFS = "\t"
+	if (calibrate) {
+		print "name", "cycles", "budget", "suggested"
+	} else {
+		print "name", "cycles", "budget", "status"
+	}
+	fails = -1
+}
+
+{
+	gsub(/\033\[[0-9;]*m/, "")
+}
+
+match($0, /BENCH_END [0-9]+/) {
+	split(substr($0, RSTART, RLENGTH), f, " ")
+	fails = f[2]
+	next
+}
+
+match($0, /BENCH [^ ]+ [0-9]+ [0-9]+ [A-Za-z]+/) {
+	split(substr($0, RSTART, RLENGTH), f, " ")
+	if (calibrate) {
+		print f[2], f[3], f[4], (f[5] == "ref") ? "-" : int((f[3] * 1.25 + 9) / 10) * 10
+	} else {
+		print f[2], f[3], f[4], f[5]
+	}
+}
+
+END {
+	if (fails < 0) {
+		print "bench: simulation did not finish" > "/dev/stderr"
+		exit 1
+	}
+	if (fails > 0 && !calibrate) {
+		print "bench: " fails " benchmark(s) over budget" > "/dev/stderr"
+		if (strict) {
+			exit 1
+		}
+		print "bench: not failing, the budgets aren't calibrated yet (BENCH_STRICT=0)" > "/dev/stderr"
+	}
+}
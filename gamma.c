@@ -0,0 +1,21 @@
+#include <avr/pgmspace.h>
+#include <stdint.h>
+
+#include "gamma.h"
+
+// The table is generated by the compiler - pow() of a constant is folded
+// at compile time, there's no floating point math in the firmware.
+
+/** One table entry, 8.8 fixed point */
+#define GAMMA_ENTRY(i) \
+	((uint16_t)(__builtin_pow((i) / 255.0, GAMMA) * BRIGHTNESS * 256.0 + 0.5))
+
+#define G4(i)   GAMMA_ENTRY(i), GAMMA_ENTRY((i) + 1), GAMMA_ENTRY((i) + 2), GAMMA_ENTRY((i) + 3)
+#define G16(i)  G4(i), G4((i) + 4), G4((i) + 8), G4((i) + 12)
+#define G64(i)  G16(i), G16((i) + 16), G16((i) + 32), G16((i) + 48)
+
+const uint16_t gamma_lut[256] PROGMEM = {
+	G64(0), G64(64), G64(128), G64(192)
+};
+
+_Static_assert(BRIGHTNESS >= 0 && BRIGHTNESS <= 255, "BRIGHTNESS must be 0..255");
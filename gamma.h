@@ -0,0 +1,51 @@
+#pragma once
+
+//
+//  Gamma correction and brightness for the LED output.
+//
+//  The LEDs' brightness is linear in the PWM duty, but the eye isn't -
+//  with values sent as they are, the dark end looks washed out and fades
+//  step visibly. The values are mapped through a lookup table in flash,
+//  computed by the compiler from GAMMA and BRIGHTNESS:
+//
+//    out = BRIGHTNESS * (in / 255) ^ GAMMA
+//
+//  The table has 8 fractional bits. When the output is rounded, those
+//  are lost; with temporal dithering, each LED alternates between the
+//  two nearest output levels from frame to frame, so the average keeps
+//  2 more bits (see STRIP_DITHER in strip.h).
+//
+
+#include <avr/pgmspace.h>
+#include <stdint.h>
+
+/** Gamma exponent (1.0 = linear) */
+#ifndef GAMMA
+#define GAMMA 2.2
+#endif
+
+/** Max output value, 0..255 */
+#ifndef BRIGHTNESS
+#define BRIGHTNESS 255
+#endif
+
+/** Output value for each input value, 8.8 fixed point */
+extern const uint16_t gamma_lut[256] PROGMEM;
+
+/** Threshold for plain rounding (no dithering) */
+#define GAMMA_ROUND 0x80
+
+/** Dithering threshold for a LED in a frame - 4 steps, neighbours get different phases */
+static inline uint8_t gamma_dither(uint8_t frame, uint16_t led)
+{
+	uint8_t k = (uint8_t)(frame + led) & 3;
+
+	// 32, 160, 96, 224 (0, 2, 1, 3 x 64, + 32)
+	return (uint8_t)(32 + (((k & 1) << 7) | ((k & 2) << 5)));
+}
+
+/** Apply gamma and brightness to a value. thr = GAMMA_ROUND or a dithering threshold */
+static inline uint8_t gamma_apply(uint8_t v, uint8_t thr)
+{
+	return (uint8_t)((pgm_read_word(&gamma_lut[v]) + thr) >> 8);
+}
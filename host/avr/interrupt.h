@@ -0,0 +1,14 @@
+#pragma once
+
+//
+// Host mock of <avr/interrupt.h>
+//
+// ISRs become normal functions, tests and benchmarks can call them.
+//
+
+#include <avr/io.h>
+
+#define ISR(vector, ...) void vector(void); void vector(void)
+
+#define sei() do { SREG |= _BV(SREG_I); } while (0)
+#define cli() do { SREG &= ~_BV(SREG_I); } while (0)
@@ -0,0 +1,162 @@
+#pragma once
+
+//
+// Host mock of <avr/io.h>
+//
+// The I/O registers are plain variables (defined in host/mock.c),
+// so the register-level code from lib/ builds and runs on a PC.
+// Only the ATmega328P registers used by this project are here.
+//
+
+#include <stdint.h>
+
+#define _BV(bit) (1 << (bit))
+#define _SFR_IO_ADDR(sfr) ((uintptr_t) &(sfr))
+
+#define RAMEND 0x8FF
+
+#define MOCK_REG8(name)  extern volatile uint8_t name
+#define MOCK_REG16(name) extern volatile uint16_t name
+
+// GPIO
+MOCK_REG8(PINB);
+MOCK_REG8(DDRB);
+MOCK_REG8(PORTB);
+MOCK_REG8(PINC);
+MOCK_REG8(DDRC);
+MOCK_REG8(PORTC);
+MOCK_REG8(PIND);
+MOCK_REG8(DDRD);
+MOCK_REG8(PORTD);
+
+// Status & interrupts
+MOCK_REG8(SREG);
+MOCK_REG8(SMCR);
+MOCK_REG8(PCICR);
+MOCK_REG8(PCIFR);
+MOCK_REG8(PCMSK0);
+MOCK_REG8(PCMSK1);
+MOCK_REG8(PCMSK2);
+
+// Timer0
+MOCK_REG8(TCCR0A);
+MOCK_REG8(TCCR0B);
+MOCK_REG8(TCNT0);
+MOCK_REG8(OCR0A);
+MOCK_REG8(OCR0B);
+MOCK_REG8(TIMSK0);
+MOCK_REG8(TIFR0);
+
+// Timer1
+MOCK_REG8(TCCR1A);
+MOCK_REG8(TCCR1B);
+MOCK_REG8(TCCR1C);
+MOCK_REG16(TCNT1);
+MOCK_REG16(ICR1);
+MOCK_REG16(OCR1A);
+MOCK_REG16(OCR1B);
+MOCK_REG8(TIMSK1);
+MOCK_REG8(TIFR1);
+
+// Timer2
+MOCK_REG8(TCCR2A);
+MOCK_REG8(TCCR2B);
+MOCK_REG8(TCNT2);
+MOCK_REG8(OCR2A);
+MOCK_REG8(OCR2B);
+MOCK_REG8(TIMSK2);
+MOCK_REG8(TIFR2);
+
+// SPI
+MOCK_REG8(SPCR);
+MOCK_REG8(SPSR);
+MOCK_REG8(SPDR);
+
+// USART
+MOCK_REG8(UCSR0A);
+MOCK_REG8(UCSR0B);
+MOCK_REG8(UCSR0C);
+MOCK_REG8(UBRR0L);
+MOCK_REG8(UBRR0H);
+MOCK_REG8(UDR0);
+
+// --- Bit numbers ---
+
+#define SREG_I 7
+
+#define SE 0
+#define SM0 1
+
+#define PCIE0 0
+#define PCIE1 1
+#define PCIE2 2
+
+#define PB0 0
+#define PB1 1
+#define PB2 2
+#define PB3 3
+#define PB4 4
+#define PB5 5
+
+#define PC0 0
+#define PC1 1
+#define PC2 2
+#define PC3 3
+#define PC4 4
+#define PC5 5
+
+#define PD0 0
+#define PD1 1
+#define PD2 2
+#define PD3 3
+#define PD4 4
+#define PD5 5
+#define PD6 6
+#define PD7 7
+
+#define CS00 0
+#define WGM00 0
+#define WGM01 1
+#define TOIE0 0
+#define OCIE0A 1
+#define TOV0 0
+
+#define CS10 0
+#define WGM12 3
+#define ICES1 6
+#define ICNC1 7
+#define TOIE1 0
+#define OCIE1A 1
+#define OCIE1B 2
+#define ICIE1 5
+#define TOV1 0
+#define OCF1A 1
+#define OCF1B 2
+#define ICF1 5
+
+#define CS20 0
+#define WGM21 1
+#define OCIE2A 1
+#define OCF2A 1
+
+#define SPR0 0
+#define SPR1 1
+#define CPHA 2
+#define CPOL 3
+#define MSTR 4
+#define DORD 5
+#define SPE 6
+#define SPIE 7
+#define SPI2X 0
+#define SPIF 7
+
+#define U2X0 1
+#define UDRE0 5
+#define TXC0 6
+#define RXC0 7
+#define TXEN0 3
+#define RXEN0 4
+#define UDRIE0 5
+#define TXCIE0 6
+#define RXCIE0 7
+#define UCSZ00 1
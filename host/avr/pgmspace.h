@@ -0,0 +1,18 @@
+#pragma once
+
+//
+// Host mock of <avr/pgmspace.h> - program memory is just memory
+//
+
+#include <stdint.h>
+#include <string.h>
+
+#define PROGMEM
+#define PSTR(s) (s)
+
+#define pgm_read_byte(addr) (*(const uint8_t *)(addr))
+#define pgm_read_word(addr) (*(const uint16_t *)(addr))
+#define pgm_read_ptr(addr) (*(void * const *)(addr))
+
+#define strlen_P strlen
+#define memcpy_P memcpy
@@ -0,0 +1,12 @@
+#pragma once
+
+//
+// Host mock of <avr/sleep.h> - sleeping returns right away
+//
+
+#define SLEEP_MODE_IDLE 0
+
+#define set_sleep_mode(mode) do { } while (0)
+#define sleep_enable() do { } while (0)
+#define sleep_disable() do { } while (0)
+#define sleep_cpu() do { } while (0)
@@ -0,0 +1,413 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+
+#include "mock.h"
+#include "lib/mbuf.h"
+#include "lib/median.h"
+#include "lib/track.h"
+#include "sonar.h"
+#include "pipeline.h"
+#include "strip.h"
+
+//
+// Host benchmark of the signal pipeline and the LED history.
+//
+// Pushes synthetic echo samples through the same code the firmware uses
+// and prints the time per call and a checksum of the results. The checksum
+// only changes when the output changes - compare it before and after
+// a change that should only make things faster.
+//
+// The spike filters (lib/median.h) are also run on the converted samples
+// alone and compared with the true distance: "spikes" counts the outputs
+// off by more than SPIKE_LEVELS. A filter leaving more spikes than its
+// limit (a fraction of the unfiltered ones) fails the benchmark - the
+// exit code is 1 then.
+//
+// The smoothing latency is replayed on a step (someone steps in front of
+// a sensor) and a ramp (walking towards it), for the moving average and
+// the tracker with the settings from pipeline.h. A still target with
+// measurement noise shows how much of the noise gets through.
+//
+//   host/bench [samples]
+//
+
+/** Echo timeout used by the sonar scheduler (Timer1 ticks) */
+#define BENCH_TIMEOUT 15000
+
+/** Default number of echo samples */
+#define BENCH_SAMPLES 3000000UL
+
+/** Filter error counted as a spike (channel value levels) */
+#define SPIKE_LEVELS 16
+
+/** Most spikes a filter may leave, per mille of the unfiltered ones */
+#define SPIKE_LIMIT_MEDIAN 5
+#define SPIKE_LIMIT_HAMPEL 10
+
+/** Fewest unfiltered spikes, per mille of the samples - else the input has too few to judge */
+#define SPIKE_MIN_INPUT 10
+
+
+static uint32_t rng_state = 12345;
+
+/** Deterministic pseudo-random numbers (LCG) */
+static uint32_t rng(void)
+{
+	rng_state = rng_state * 1664525UL + 1013904223UL;
+	return rng_state >> 8;
+}
+
+
+/** Synthetic sensor: someone walking around, with timeouts and spikes */
+typedef struct {
+	int32_t pos;
+	int32_t vel;
+} SynthSensor;
+
+static uint16_t synth_echo(SynthSensor *s)
+{
+	uint32_t r = rng();
+
+	s->vel += (int32_t)(r % 21) - 10;
+	if (s->vel > 60) s->vel = 60;
+	if (s->vel < -60) s->vel = -60;
+
+	s->pos += s->vel;
+	if (s->pos < 300) { s->pos = 300; s->vel = -s->vel; }
+	if (s->pos > 14000) { s->pos = 14000; s->vel = -s->vel; }
+
+	switch ((r >> 12) % 64) {
+		case 0: return BENCH_TIMEOUT; // no echo
+		case 1: return (uint16_t)(200 + (r >> 20) % 1000); // ghost echo
+		default: return (uint16_t) s->pos;
+	}
+}
+
+
+static double now_s(void)
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (double) ts.tv_sec + ts.tv_nsec * 1e-9;
+}
+
+
+static void report(const char *name, unsigned long calls, double secs, uint32_t check)
+{
+	printf("%-24s %10lu %10.2f %12.1f   %08x\n",
+	       name, calls, secs * 1e9 / (double) calls, (double) calls / secs / 1e6, check);
+}
+
+
+/**
+ * Run a spike filter over the converted samples, count the spikes
+ *
+ * len: window length, 0 = no filter
+ * hampel: Hampel filter instead of the median
+ * Returns the number of spikes.
+ */
+static unsigned long filter_stage(const char *name, const uint16_t *echoes, const uint16_t *truth,
+                         unsigned long samples, uint8_t len, bool hampel)
+{
+	MedBuf bufs[PIPE_CHANNELS];
+	uint16_t mem[PIPE_CHANNELS][2][9];
+
+	for (uint8_t i = 0; i < PIPE_CHANNELS; i++) {
+		bufs[i] = (MedBuf) { mem[i][0], mem[i][1], len, 0 };
+		for (uint8_t j = 0; j < 9; j++) {
+			mem[i][0][j] = mem[i][1][j] = 0;
+		}
+	}
+
+	uint32_t check = 0;
+	unsigned long spikes = 0;
+
+	double t = now_s();
+	for (unsigned long i = 0; i < samples; i++) {
+		uint8_t ch = (uint8_t)(i % PIPE_CHANNELS);
+		uint16_t v = pipe_convert(ch, echoes[i]);
+
+		if (len == 0) {
+			// unfiltered
+		} else if (hampel) {
+			v = medbuf_hampel(&bufs[ch], v, MEDBUF_HAMPEL_K(PIPE_HAMPEL_K), PIPE_HAMPEL_MIN);
+		} else {
+			v = medbuf_add(&bufs[ch], v);
+		}
+
+		check = check * 31 + v;
+		if (abs((int32_t) v - (int32_t) truth[i]) > (SPIKE_LEVELS << 8)) {
+			spikes++;
+		}
+	}
+	double secs = now_s() - t;
+
+	report(name, samples, secs, check);
+	printf("%-24s %10lu spikes\n", "", spikes);
+	return spikes;
+}
+
+
+/** Check a spike count against a limit (per mille of base), print a failure */
+static bool spikes_ok(const char *name, unsigned long spikes, unsigned long base, unsigned permille)
+{
+	if (spikes * 1000 < base * permille) {
+		return true;
+	}
+
+	printf("FAIL %s: %lu spikes, the limit is %u per mille of %lu\n", name, spikes, permille, base);
+	return false;
+}
+
+
+/** Length of the step / ramp replay, frames */
+#define STEP_FRAMES 64
+
+/** Frame where the step / ramp starts */
+#define STEP_AT 16
+
+/** Length of the noise replay, frames (the first STEP_AT are left out, it settles) */
+#define NOISE_FRAMES 4096
+
+/** Noise replay distance (Timer1 ticks, 50 cm) */
+#define NOISE_ECHO 5800
+
+/** Measurement noise: a sum of 4 uniform draws of +- NOISE_TICKS, about 35 ticks (6 mm) RMS */
+#define NOISE_TICKS 30
+
+
+/** Smoothing under test - a moving average of mean_len, or the tracker if 0 */
+typedef struct {
+	uint8_t mean_len;
+	uint16_t data[255];
+	MBuf mb;
+	Track tr;
+	bool started;
+} Smooth;
+
+
+static void smooth_init(Smooth *s, uint8_t mean_len)
+{
+	memset(s, 0, sizeof(*s));
+	s->mean_len = mean_len;
+	s->mb = (MBuf) { s->data, mean_len, 0, MBUF_SHIFT(mean_len), 0 };
+}
+
+
+/** Smooth one sample; the first one pre-fills the state, as if it had been running */
+static uint16_t smooth_add(Smooth *s, uint16_t in)
+{
+	if (s->mean_len) {
+		if (!s->started) {
+			for (uint8_t i = 0; i < s->mean_len; i++) {
+				mbuf_add(&s->mb, in);
+			}
+		}
+		s->started = true;
+		return mbuf_add(&s->mb, in);
+	}
+
+	if (!s->started) {
+		s->tr.pos = (int32_t) in << TRACK_FRAC;
+	}
+	s->started = true;
+	track_update(&s->tr, in, TRACK_COEF(PIPE_TRACK_ALPHA), TRACK_COEF(PIPE_TRACK_BETA));
+	return track_predict(&s->tr, PIPE_TRACK_LEAD);
+}
+
+
+/** Noisy echo of a still target (Timer1 ticks) */
+static uint16_t noise_echo(void)
+{
+	int32_t echo = NOISE_ECHO;
+
+	for (uint8_t i = 0; i < 4; i++) {
+		echo += (int32_t)(rng() % (2 * NOISE_TICKS + 1)) - NOISE_TICKS;
+	}
+	return (uint16_t) echo;
+}
+
+
+/**
+ * Replay a step, a ramp and a still target through the smoothing, print
+ * the delays and the jitter
+ *
+ * mean_len: moving average of mean_len, or the tracker if 0
+ */
+static void smooth_latency(const char *name, uint8_t mean_len)
+{
+	uint16_t step[STEP_FRAMES];
+	uint16_t ramp[STEP_FRAMES];
+	Smooth s;
+
+	// far (no echo) -> 50 cm; and walking closer at 1.25 cm per frame
+	for (uint8_t f = 0; f < STEP_FRAMES; f++) {
+		step[f] = pipe_convert(0, f < STEP_AT ? BENCH_TIMEOUT : NOISE_ECHO);
+		ramp[f] = pipe_convert(0, f < STEP_AT ? 7500 : (uint16_t)(7500 - (f - STEP_AT) * 145));
+	}
+
+	// step: delays to 50 and 90 % of the step, overshoot
+	uint16_t lo = step[0], hi = step[STEP_FRAMES - 1];
+	int f50 = -1, f90 = -1;
+	uint16_t peak = 0;
+
+	smooth_init(&s, mean_len);
+	for (uint8_t f = 0; f < STEP_FRAMES; f++) {
+		uint16_t out = smooth_add(&s, step[f]);
+
+		if (f50 < 0 && out >= lo + (hi - lo) / 2) f50 = f - STEP_AT;
+		if (f90 < 0 && out >= lo + (uint32_t)(hi - lo) * 9 / 10) f90 = f - STEP_AT;
+		if (out > peak) peak = out;
+	}
+
+	printf("%-24s step: 50%% after %d, 90%% after %d frames (%d / %d ms), overshoot %d\n",
+	       name, f50, f90, f50 * (int) SONAR_FRAME_MS, f90 * (int) SONAR_FRAME_MS,
+	       (peak - hi + 128) >> 8);
+
+	// ramp: how far behind the input it ends up
+	uint16_t out = 0;
+
+	smooth_init(&s, mean_len);
+	for (uint8_t f = 0; f < STEP_FRAMES; f++) {
+		out = smooth_add(&s, ramp[f]);
+	}
+
+	int32_t lag = (int32_t) ramp[STEP_FRAMES - 1] - out;
+	int32_t slope = (int32_t) ramp[STEP_FRAMES - 1] - ramp[STEP_FRAMES - 2];
+	printf("%-24s ramp: behind by %d levels (%.1f frames)\n", "",
+	       (int)((lag + 128) >> 8), (double) lag / slope);
+
+	// still target: RMS distance of the input and the output from the true value
+	int32_t base = pipe_convert(0, NOISE_ECHO);
+	double in_sq = 0, out_sq = 0;
+
+	rng_state = 54321;
+	smooth_init(&s, mean_len);
+	for (uint16_t f = 0; f < NOISE_FRAMES; f++) {
+		int32_t in = pipe_convert(0, noise_echo());
+		int32_t out = smooth_add(&s, (uint16_t) in);
+
+		if (f >= STEP_AT) {
+			in_sq += (double)(in - base) * (in - base);
+			out_sq += (double)(out - base) * (out - base);
+		}
+	}
+
+	printf("%-24s noise: %.2f levels RMS (input %.2f)\n", "",
+	       sqrt(out_sq / (NOISE_FRAMES - STEP_AT)) / 256, sqrt(in_sq / (NOISE_FRAMES - STEP_AT)) / 256);
+}
+
+
+int main(int argc, char **argv)
+{
+	unsigned long samples = BENCH_SAMPLES;
+
+	if (argc > 1) {
+		samples = strtoul(argv[1], NULL, 10);
+	}
+
+	unsigned long frames = samples / PIPE_CHANNELS;
+
+	// Pre-generate the input so the generator isn't measured
+	uint16_t *echoes = calloc(samples, sizeof(uint16_t));
+	uint16_t *truth = calloc(samples, sizeof(uint16_t));
+	if (echoes == NULL || truth == NULL) {
+		return 1;
+	}
+
+	// spread out over the range (1000, 5000, 9000, ... for the default three)
+	SynthSensor sensors[PIPE_CHANNELS];
+	for (uint8_t i = 0; i < PIPE_CHANNELS; i++) {
+		sensors[i].pos = 1000 + (int32_t)(i * 4000) % 13000;
+		sensors[i].vel = 0;
+	}
+	for (unsigned long i = 0; i < samples; i++) {
+		uint8_t ch = (uint8_t)(i % PIPE_CHANNELS);
+		echoes[i] = synth_echo(&sensors[ch]);
+		// what the sensor should have seen, as a channel value
+		truth[i] = pipe_convert(ch, (uint16_t) sensors[ch].pos);
+	}
+
+	mock_reset();
+
+	printf("%-24s %10s %10s %12s   %s\n", "stage", "calls", "ns/call", "Mcalls/s", "check");
+
+	// --- echo to value conversion ---
+	{
+		uint32_t check = 0;
+		double t = now_s();
+		for (unsigned long i = 0; i < samples; i++) {
+			check = check * 31 + pipe_convert((uint8_t)(i % PIPE_CHANNELS), echoes[i]);
+		}
+		report("pipe_convert", samples, now_s() - t, check);
+	}
+
+	// --- spike filters alone ---
+	bool ok = true;
+	unsigned long spikes = filter_stage("filter_none", echoes, truth, samples, 0, false);
+
+	if (spikes * 1000 < samples * SPIKE_MIN_INPUT) {
+		printf("FAIL filter_none: only %lu spikes in the input\n", spikes);
+		ok = false;
+	}
+
+	ok &= spikes_ok("filter_median_5", filter_stage("filter_median_5", echoes, truth, samples, 5, false),
+	                spikes, SPIKE_LIMIT_MEDIAN);
+	ok &= spikes_ok("filter_median_7", filter_stage("filter_median_7", echoes, truth, samples, 7, false),
+	                spikes, SPIKE_LIMIT_MEDIAN);
+	ok &= spikes_ok("filter_median_9", filter_stage("filter_median_9", echoes, truth, samples, 9, false),
+	                spikes, SPIKE_LIMIT_MEDIAN);
+	ok &= spikes_ok("filter_hampel_5", filter_stage("filter_hampel_5", echoes, truth, samples, 5, true),
+	                spikes, SPIKE_LIMIT_HAMPEL);
+	ok &= spikes_ok("filter_hampel_9", filter_stage("filter_hampel_9", echoes, truth, samples, 9, true),
+	                spikes, SPIKE_LIMIT_HAMPEL);
+
+	// --- smoothing latency ---
+	smooth_latency("smooth_mean_16", 16);
+	smooth_latency("smooth_mean_4", 4);
+	smooth_latency("smooth_track", 0);
+
+	// --- conversion + averaging ---
+	{
+		uint32_t check = 0;
+		double t = now_s();
+		for (unsigned long i = 0; i < samples; i++) {
+			check = check * 31 + pipe_process((uint8_t)(i % PIPE_CHANNELS), echoes[i]);
+		}
+		report("pipe_process", samples, now_s() - t, check);
+	}
+
+	// --- full frame: all channels, history scroll, strip output ---
+	{
+		mock_ws_bytes = 0;
+		mock_ws_sum = 0;
+
+		double t = now_s();
+		for (unsigned long f = 0; f < frames; f++) {
+			const uint16_t *e = &echoes[f * PIPE_CHANNELS];
+			uint8_t values[PIPE_CHANNELS];
+			RGB color;
+
+			for (uint8_t i = 0; i < PIPE_CHANNELS; i++) {
+				values[i] = pipe_process(i, e[i]);
+			}
+			pipe_mix(values, &color);
+
+			strip_push(color.r, color.g, color.b);
+			strip_show();
+		}
+		report("frame", frames, now_s() - t, mock_ws_sum);
+
+		printf("\n%lu frames, %d LEDs, %lu bytes to the strip\n",
+		       frames, LED_COUNT, (unsigned long) mock_ws_bytes);
+	}
+
+	free(echoes);
+	free(truth);
+	return ok ? 0 : 1;
+}
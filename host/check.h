@@ -0,0 +1,39 @@
+#pragma once
+
+//
+// Minimal assertions for the host tests (host/test_*.c)
+//
+// A failed check prints where it failed and the test goes on;
+// check_exit() returns the exit code for main().
+//
+
+#include <stdio.h>
+
+static unsigned check_count;
+static unsigned check_fails;
+
+/** Check a condition */
+#define CHECK(cond) do { \
+		check_count++; \
+		if (!(cond)) { \
+			check_fails++; \
+			printf("%s:%d: failed: %s\n", __FILE__, __LINE__, #cond); \
+		} \
+	} while (0)
+
+/** Check that two integers are equal */
+#define CHECK_EQ(a, b) do { \
+		long _a = (long)(a), _b = (long)(b); \
+		check_count++; \
+		if (_a != _b) { \
+			check_fails++; \
+			printf("%s:%d: failed: %s == %s (%ld != %ld)\n", __FILE__, __LINE__, #a, #b, _a, _b); \
+		} \
+	} while (0)
+
+/** Print the result, returns the exit code */
+static inline int check_exit(const char *name)
+{
+	printf("%-16s %u checks, %u failed\n", name, check_count, check_fails);
+	return check_fails ? 1 : 0;
+}
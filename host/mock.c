@@ -0,0 +1,99 @@
+#include <stdint.h>
+
+#include <avr/io.h>
+
+#include "mock.h"
+
+#define MOCK_DEF8(name)  volatile uint8_t name
+#define MOCK_DEF16(name) volatile uint16_t name
+
+MOCK_DEF8(PINB);
+MOCK_DEF8(DDRB);
+MOCK_DEF8(PORTB);
+MOCK_DEF8(PINC);
+MOCK_DEF8(DDRC);
+MOCK_DEF8(PORTC);
+MOCK_DEF8(PIND);
+MOCK_DEF8(DDRD);
+MOCK_DEF8(PORTD);
+
+MOCK_DEF8(SREG);
+MOCK_DEF8(SMCR);
+MOCK_DEF8(PCICR);
+MOCK_DEF8(PCIFR);
+MOCK_DEF8(PCMSK0);
+MOCK_DEF8(PCMSK1);
+MOCK_DEF8(PCMSK2);
+
+MOCK_DEF8(TCCR0A);
+MOCK_DEF8(TCCR0B);
+MOCK_DEF8(TCNT0);
+MOCK_DEF8(OCR0A);
+MOCK_DEF8(OCR0B);
+MOCK_DEF8(TIMSK0);
+MOCK_DEF8(TIFR0);
+
+MOCK_DEF8(TCCR1A);
+MOCK_DEF8(TCCR1B);
+MOCK_DEF8(TCCR1C);
+MOCK_DEF16(TCNT1);
+MOCK_DEF16(ICR1);
+MOCK_DEF16(OCR1A);
+MOCK_DEF16(OCR1B);
+MOCK_DEF8(TIMSK1);
+MOCK_DEF8(TIFR1);
+
+MOCK_DEF8(TCCR2A);
+MOCK_DEF8(TCCR2B);
+MOCK_DEF8(TCNT2);
+MOCK_DEF8(OCR2A);
+MOCK_DEF8(OCR2B);
+MOCK_DEF8(TIMSK2);
+MOCK_DEF8(TIFR2);
+
+MOCK_DEF8(SPCR);
+MOCK_DEF8(SPSR);
+MOCK_DEF8(SPDR);
+
+MOCK_DEF8(UCSR0A);
+MOCK_DEF8(UCSR0B);
+MOCK_DEF8(UCSR0C);
+MOCK_DEF8(UBRR0L);
+MOCK_DEF8(UBRR0H);
+MOCK_DEF8(UDR0);
+
+uint32_t mock_ws_bytes;
+uint32_t mock_ws_sum;
+
+
+/** Reset all registers to their power-on state */
+void mock_reset(void)
+{
+	PINB = DDRB = PORTB = 0;
+	PINC = DDRC = PORTC = 0;
+	PIND = DDRD = PORTD = 0;
+
+	SREG = SMCR = 0;
+	PCICR = PCIFR = PCMSK0 = PCMSK1 = PCMSK2 = 0;
+
+	TCCR0A = TCCR0B = TCNT0 = OCR0A = OCR0B = TIMSK0 = TIFR0 = 0;
+	TCCR1A = TCCR1B = TCCR1C = TIMSK1 = TIFR1 = 0;
+	TCNT1 = ICR1 = OCR1A = OCR1B = 0;
+	TCCR2A = TCCR2B = TCNT2 = OCR2A = OCR2B = TIMSK2 = TIFR2 = 0;
+
+	SPCR = SPDR = 0;
+	SPSR = _BV(SPIF); // transfers finish immediately
+
+	UCSR0A = _BV(UDRE0); // always ready to send
+	UCSR0B = UCSR0C = UBRR0L = UBRR0H = UDR0 = 0;
+
+	mock_ws_bytes = 0;
+	mock_ws_sum = 0;
+}
+
+
+/** Advance Timer1 by a number of ticks */
+void mock_timer1_advance(uint16_t ticks)
+{
+	TCNT1 = (uint16_t)(TCNT1 + ticks);
+}
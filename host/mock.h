@@ -0,0 +1,17 @@
+#pragma once
+
+//
+// Host mock of the AVR hardware - helpers for tests and benchmarks
+//
+
+#include <stdint.h>
+
+/** Reset all registers to their power-on state */
+void mock_reset(void);
+
+/** Advance Timer1 by a number of ticks */
+void mock_timer1_advance(uint16_t ticks);
+
+/** Bytes sent to the LED strip since the last reset, and their checksum */
+extern uint32_t mock_ws_bytes;
+extern uint32_t mock_ws_sum;
@@ -0,0 +1,142 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <avr/io.h>
+
+#include "mock.h"
+#include "check.h"
+#include "lib/debounce.h"
+
+//
+// Host test of the debouncer (lib/debounce.c).
+//
+// The vertical counters are run side by side with the debouncer they
+// replaced - a counter per pin, kept here as the reference - on pins that
+// change now and then and bounce in bursts. The debounced states and the
+// handler calls must be the same on every tick.
+//
+
+/** Ticks to run */
+#define TICKS 2000000L
+
+/** The pins: A0..A5 and D2..D6 */
+#define PIN_REG(i) ((i) < 6 ? &PINC : &PIND)
+#define PIN_BIT(i) ((uint8_t)((i) < 6 ? (i) : (i) - 4))
+
+uint8_t systick_add(void (*handler)(void))
+{
+	(void) handler;
+	return 0;
+}
+
+
+/** The old debouncer: one counter per pin */
+typedef struct {
+	uint8_t count;
+	bool state;
+} RefSlot;
+
+static RefSlot ref[DEBO_CHANNELS];
+
+/** Handler calls expected and seen since the last tick, bit per channel */
+static uint16_t ref_calls;
+static uint16_t calls;
+static unsigned wrong_state;
+
+
+static void ref_tick(void)
+{
+	for (uint8_t i = 0; i < DEBO_CHANNELS; i++) {
+		bool state = (*PIN_REG(i) >> PIN_BIT(i)) & 1;
+
+		if (state != ref[i].state) {
+			if (ref[i].count < DEBO_TICKS) {
+				ref[i].count++;
+			} else {
+				ref[i].state = state;
+				ref[i].count = 0;
+				ref_calls |= (uint16_t)(1 << i);
+			}
+		} else {
+			ref[i].count = 0;
+		}
+	}
+}
+
+
+static void handler(uint8_t n, bool state)
+{
+	calls |= (uint16_t)(1 << n);
+
+	if (state != (ref[n].state ^ (n & 1))) {
+		wrong_state++;
+	}
+}
+
+
+static uint32_t rng_state = 1;
+
+/** Deterministic pseudo-random numbers (LCG) */
+static uint32_t rng(void)
+{
+	rng_state = rng_state * 1664525UL + 1013904223UL;
+	return rng_state >> 16;
+}
+
+
+int main(void)
+{
+	mock_reset();
+
+	for (uint8_t i = 0; i < DEBO_CHANNELS; i++) {
+		if (i == DEBO_CHANNELS - 1) {
+			// not a pin register - refused, and the slot stays free
+			CHECK_EQ(debo_add_do(&PORTB, PB0, false, NULL), DEBO_NONE);
+		}
+		CHECK_EQ(debo_add_do(PIN_REG(i), PIN_BIT(i), i & 1, handler), i);
+	}
+
+	// all taken
+	CHECK_EQ(debo_add_do(&PINB, PB0, false, NULL), DEBO_NONE);
+
+	unsigned mismatches = 0;
+	unsigned wrong_calls = 0;
+	unsigned changes = 0;
+
+	for (long t = 0; t < TICKS; t++) {
+		// now and then a pin changes, and every 500 ticks port C bounces for a while
+		if (rng() % 40 == 0) {
+			PINC ^= (uint8_t)(1 << (rng() % 6));
+		}
+		if (rng() % 40 == 0) {
+			PIND ^= (uint8_t)(1 << (2 + rng() % 5));
+		}
+		if (t % 500 < 30 && rng() % 3 == 0) {
+			PINC ^= (uint8_t)(rng() & 0x3F);
+		}
+
+		ref_calls = 0;
+		calls = 0;
+		ref_tick();
+		debo_tick();
+
+		for (uint8_t i = 0; i < DEBO_CHANNELS; i++) {
+			if (debo_get_pin(i) != (ref[i].state ^ (i & 1))) {
+				mismatches++;
+			}
+		}
+		if (calls != ref_calls) {
+			wrong_calls++;
+		}
+		for (uint16_t c = ref_calls; c; c &= (uint16_t)(c - 1)) {
+			changes++;
+		}
+	}
+
+	CHECK_EQ(mismatches, 0);
+	CHECK_EQ(wrong_calls, 0);
+	CHECK_EQ(wrong_state, 0);
+	CHECK(changes > 1000); // the pins did change, and bouncing was filtered out
+
+	return check_exit("debounce");
+}
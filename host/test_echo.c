@@ -0,0 +1,175 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <avr/io.h>
+
+#include "mock.h"
+#include "check.h"
+#include "lib/echo.h"
+
+//
+// Host test of the echo capture (lib/echo.c).
+//
+// Plays scripted echo waveforms into the pin registers and calls the
+// interrupt handlers the way the hardware would: a pin-change interrupt
+// for any change of an enabled pin, the input capture only on the edge
+// selected by ICES1. Checks the measured rise times and widths.
+//
+
+void PCINT0_vect(void);
+void PCINT1_vect(void);
+void PCINT2_vect(void);
+void TIMER1_CAPT_vect(void);
+
+/** Change a pin at a Timer1 time, run the interrupt it causes */
+static void edge(volatile uint8_t *pin_reg, uint8_t bit, bool level, uint16_t t)
+{
+	uint8_t mask = (uint8_t)(1 << bit);
+
+	if (((*pin_reg & mask) != 0) == level) {
+		return; // no change
+	}
+
+	*pin_reg ^= mask;
+	TCNT1 = t;
+
+	if (pin_reg == &PINB && bit == PB0) {
+		// input capture, on the selected edge only
+		if ((TIMSK1 & _BV(ICIE1)) && level == ((TCCR1B & _BV(ICES1)) != 0)) {
+			ICR1 = t;
+			TCNT1 = (uint16_t)(t + 3); // the ISR starts a bit later
+			TIMER1_CAPT_vect();
+		}
+		return;
+	}
+
+	if (pin_reg == &PINB && (PCICR & _BV(PCIE0)) && (PCMSK0 & mask)) {
+		PCINT0_vect();
+	} else if (pin_reg == &PINC && (PCICR & _BV(PCIE1)) && (PCMSK1 & mask)) {
+		PCINT1_vect();
+	} else if (pin_reg == &PIND && (PCICR & _BV(PCIE2)) && (PCMSK2 & mask)) {
+		PCINT2_vect();
+	}
+}
+
+
+/** Scripted edge */
+typedef struct {
+	uint16_t t;
+	volatile uint8_t *reg;
+	uint8_t bit;
+	bool level;
+} Edge;
+
+static void play(const Edge *edges, uint8_t n)
+{
+	for (uint8_t i = 0; i < n; i++) {
+		edge(edges[i].reg, edges[i].bit, edges[i].level, edges[i].t);
+	}
+}
+
+
+int main(void)
+{
+	mock_reset();
+
+	uint8_t d2 = echo_add_do(&PIND, PD2);
+	uint8_t d4 = echo_add_do(&PIND, PD4);
+	uint8_t d8 = echo_add_do(&PINB, PB0);
+	uint8_t a0 = echo_add_do(&PINC, PC0);
+	echo_init();
+
+	CHECK_EQ(d2, 0);
+	CHECK_EQ(d4, 1);
+	CHECK_EQ(d8, 2);
+	CHECK_EQ(a0, 3);
+	CHECK_EQ(PCMSK2, _BV(PD2) | _BV(PD4));
+	CHECK_EQ(PCMSK0, 0); // D8 uses the input capture
+	CHECK_EQ(PCMSK1, _BV(PC0));
+
+	// a pulse before arming is ignored
+	const Edge early[] = {
+		{ 100, &PIND, PD2, 1 },
+		{ 900, &PIND, PD2, 0 },
+	};
+	play(early, 2);
+	CHECK(!echo_ready(d2) && !echo_busy(d2));
+
+	// two sensors on one port, the pulses overlap
+	echo_arm(d2);
+	echo_arm(d4);
+	CHECK(echo_busy(d2) && !echo_in_pulse(d2));
+
+	const Edge overlap[] = {
+		{ 1500, &PIND, PD2, 1 },
+		{ 2000, &PIND, PD4, 1 },
+		{ 4500, &PIND, PD2, 0 },
+		{ 9000, &PIND, PD4, 0 },
+	};
+	play(overlap, 2);
+	CHECK(echo_in_pulse(d2) && echo_in_pulse(d4));
+	CHECK_EQ(echo_rise(d2), 1500);
+	play(overlap + 2, 2);
+	CHECK(echo_ready(d2) && echo_ready(d4));
+	CHECK_EQ(echo_width(d2), 3000);
+	CHECK_EQ(echo_width(d4), 7000);
+
+	// more edges after the pulse don't change the result
+	const Edge ringing[] = {
+		{ 9500, &PIND, PD2, 1 },
+		{ 9600, &PIND, PD2, 0 },
+	};
+	play(ringing, 2);
+	CHECK_EQ(echo_width(d2), 3000);
+
+	// input capture, Timer1 wraps during the pulse; the ISR latency doesn't count
+	echo_arm(d8);
+	CHECK(TIMSK1 & _BV(ICIE1));
+	CHECK(TCCR1B & _BV(ICES1));
+
+	const Edge icp[] = {
+		{ 60000, &PINB, PB0, 1 },
+		{ 1000, &PINB, PB0, 0 },
+	};
+	play(icp, 2);
+	CHECK(echo_ready(d8));
+	CHECK_EQ(echo_rise(d8), 60000);
+	CHECK_EQ(echo_width(d8), 6536);
+	CHECK(!(TIMSK1 & _BV(ICIE1)));
+
+	// an input capture pin already high when armed - waits for the next rising edge
+	PINB |= _BV(PB0);
+	echo_arm(d8);
+	const Edge icp_high[] = {
+		{ 2000, &PINB, PB0, 0 },
+		{ 3000, &PINB, PB0, 1 },
+		{ 3400, &PINB, PB0, 0 },
+	};
+	play(icp_high, 3);
+	CHECK(echo_ready(d8));
+	CHECK_EQ(echo_width(d8), 400);
+
+	// cancelled in the middle of a pulse
+	echo_arm(a0);
+	const Edge cut[] = {
+		{ 5000, &PINC, PC0, 1 },
+		{ 8000, &PINC, PC0, 0 },
+	};
+	play(cut, 1);
+	CHECK(echo_in_pulse(a0));
+	echo_cancel(a0);
+	play(cut + 1, 1);
+	CHECK(!echo_ready(a0) && !echo_busy(a0));
+
+	// the channels run out
+	uint8_t ch = a0;
+	for (uint8_t i = 4; i < ECHO_CHANNELS; i++) {
+		ch = echo_add_do(&PINC, (uint8_t)(i % 6));
+	}
+	CHECK_EQ(ch, ECHO_CHANNELS - 1);
+	CHECK_EQ(echo_add_do(&PINC, PC5), ECHO_NONE);
+	CHECK_EQ(echo_add_do(&PIND, PD7), ECHO_NONE);
+	CHECK(!(PCMSK2 & _BV(PD7)));
+
+	return check_exit("echo");
+}
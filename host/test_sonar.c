@@ -0,0 +1,319 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "mock.h"
+#include "check.h"
+
+// the scheduler's state is static - built in, so each case can start over
+#include "sonar.c"
+
+//
+// Host test of the sonar scheduler (sonar.c).
+//
+// The echo capture and the systick are replaced by a model of the room:
+// each sensor pulls its echo pin high RISE_US after its trigger, and low
+// again when the first sound gets back to it - its own ping from the
+// target in front of it, or another sensor's ping on a given path.
+// The model runs in 10 us steps, with a systick every ms. Checks the
+// order and timing of the triggers and the measured frame, with
+// sensors taking turns, running at once, and hearing each other.
+//
+
+/** Time from the trigger to the rising edge of the echo, us */
+#define RISE_US 450
+
+/** A HC-SR04 gives up on the echo after this long, us */
+#define GIVE_UP_US 38000
+
+/** Model time step, us */
+#define STEP_US 10
+
+/** Flight time of a distance there and back, us */
+#define CM_US(cm) ((uint32_t)(cm) * 58)
+
+EchoChannel echo_channels[ECHO_CHANNELS];
+
+static void (*tick_handler)(void);
+static uint32_t now_us;
+
+/** Room: flight time of each sensor's own echo (0 = nothing in front) */
+static uint32_t own_us[SONAR_COUNT];
+
+/** ..., and of the pings of one sensor to another ([from][to], 0 = not heard) */
+static uint32_t cross_us[SONAR_COUNT][SONAR_COUNT];
+
+/** Trigger (arm) and echo fall times of the frame, us (0 = not yet) */
+static uint32_t arm_at[SONAR_COUNT];
+static uint32_t fall_at[SONAR_COUNT];
+
+
+uint8_t systick_add(void (*handler)(void))
+{
+	tick_handler = handler;
+	return 0;
+}
+
+
+uint16_t systick_ms(void)
+{
+	return (uint16_t)(now_us / 1000);
+}
+
+
+uint16_t echo_now(void)
+{
+	return (uint16_t)(now_us * ECHO_TICKS_PER_US);
+}
+
+
+void echo_arm(uint8_t ch)
+{
+	arm_at[ch] = now_us;
+	echo_channels[ch].phase = ECHO_WAIT_1;
+}
+
+
+void echo_cancel(uint8_t ch)
+{
+	echo_channels[ch].phase = ECHO_IDLE;
+}
+
+
+/** Time the first sound after the rising edge gets back to a sensor, us */
+static uint32_t sound_at(uint8_t ch)
+{
+	uint32_t rise = arm_at[ch] + RISE_US;
+	uint32_t t = rise + GIVE_UP_US;
+
+	if (own_us[ch]) {
+		t = rise + own_us[ch];
+	}
+
+	for (uint8_t k = 0; k < SONAR_COUNT; k++) {
+		uint32_t at = arm_at[k] + RISE_US + cross_us[k][ch];
+
+		if (k != ch && arm_at[k] && cross_us[k][ch] && at > rise && at < t) {
+			t = at;
+		}
+	}
+	return t;
+}
+
+
+/** Move the echo pins to the current time */
+static void room_step(void)
+{
+	for (uint8_t ch = 0; ch < SONAR_COUNT; ch++) {
+		EchoChannel *c = &echo_channels[ch];
+
+		if (c->phase == ECHO_WAIT_1 && now_us >= arm_at[ch] + RISE_US) {
+			c->rise = echo_now();
+			c->phase = ECHO_WAIT_0;
+		} else if (c->phase == ECHO_WAIT_0 && now_us >= sound_at(ch)) {
+			c->width = (uint16_t)(echo_now() - c->rise);
+			c->phase = ECHO_DONE;
+			fall_at[ch] = now_us;
+		}
+	}
+}
+
+
+/** Set up the sensors, facing dirs, and an empty room */
+static void setup(const int16_t *dirs)
+{
+	mock_reset();
+	memset(echo_channels, 0, sizeof(echo_channels));
+	memset(own_us, 0, sizeof(own_us));
+	memset(cross_us, 0, sizeof(cross_us));
+	memset(arm_at, 0, sizeof(arm_at));
+	memset(fall_at, 0, sizeof(fall_at));
+
+	sonar_next_slot = 0;
+	running = false;
+	done_valid = false;
+	late = false;
+
+	for (uint8_t i = 0; i < SONAR_COUNT; i++) {
+		sonar_add_do(3 + i, i, SONAR_CM_TICKS(2), SONAR_CM_TICKS(70), dirs[i]);
+	}
+	sonar_init();
+
+	now_us = 1000; // arm_at 0 means "not armed"
+}
+
+
+/** Run until a frame is finished */
+static bool run_frame(SonarFrame *frame)
+{
+	for (uint32_t end = now_us + 200000; now_us < end; now_us += STEP_US) {
+		if (now_us % 1000 == 0) {
+			tick_handler();
+		}
+		room_step();
+
+		if (sonar_take(frame)) {
+			return true;
+		}
+	}
+	return false;
+}
+
+
+int main(void)
+{
+	SonarFrame f;
+
+	// sequential: the same way - each waits for the one before
+	{
+		static const int16_t dirs[] = { 0, 0, 0 };
+		setup(dirs);
+		own_us[0] = CM_US(20);
+		own_us[1] = CM_US(40);
+		own_us[2] = CM_US(60);
+
+		CHECK(run_frame(&f));
+		CHECK_EQ(f.echo[0], SONAR_CM_TICKS(20));
+		CHECK_EQ(f.echo[1], SONAR_CM_TICKS(40));
+		CHECK_EQ(f.echo[2], SONAR_CM_TICKS(60));
+		CHECK_EQ(f.xtalk, 0);
+		CHECK(arm_at[1] > fall_at[0]);
+		CHECK(arm_at[2] > fall_at[1]);
+		CHECK(!f.missed);
+	}
+
+	// overlapped: 120 degrees apart - fired 1 ms apart, all at once
+	{
+		static const int16_t dirs[] = { 0, 120, 240 };
+		setup(dirs);
+		own_us[0] = CM_US(20);
+		own_us[1] = CM_US(40);
+		own_us[2] = CM_US(60);
+
+		CHECK(run_frame(&f));
+		CHECK_EQ(f.echo[0], SONAR_CM_TICKS(20));
+		CHECK_EQ(f.echo[1], SONAR_CM_TICKS(40));
+		CHECK_EQ(f.echo[2], SONAR_CM_TICKS(60));
+		CHECK_EQ(f.xtalk, 0);
+		CHECK_EQ(arm_at[1] - arm_at[0], 1000);
+		CHECK_EQ(arm_at[2] - arm_at[1], 1000);
+		CHECK(arm_at[1] < fall_at[0]);
+		CHECK(f.duration_ms <= SONAR_TRIG_MS + 2 + CM_US(60) / 1000 + 1);
+	}
+
+	// quiet gap: a wall out of range in front of 0, someone in front of 1 -
+	// 1 waits until 0's ping is back, so 0 doesn't time 1's echo, and 1's
+	// echo is kept
+	{
+		static const int16_t dirs[] = { 0, 0, 0 };
+		setup(dirs);
+		own_us[0] = CM_US(150);
+		own_us[1] = CM_US(30);
+		cross_us[0][1] = CM_US(150);
+		cross_us[1][0] = CM_US(30) + 30;
+
+		CHECK(run_frame(&f));
+		CHECK_EQ(f.echo[0], SONAR_TIMEOUT);
+		CHECK_EQ(f.echo[1], SONAR_CM_TICKS(30));
+		CHECK_EQ(f.echo[2], SONAR_TIMEOUT);
+		CHECK_EQ(f.xtalk, 0);
+		CHECK(arm_at[1] > fall_at[0]);
+		CHECK_EQ(fall_at[0] - arm_at[0], RISE_US + CM_US(150));
+
+		// nothing in front of 2: the gap ends it, the frame still fits
+		CHECK_EQ(fall_at[2], 0);
+		CHECK(f.duration_ms <= SONAR_WORST_FRAME_MS);
+	}
+
+	// cross-talk: 0's ping comes back a second time, 1 hears it - dropped
+	{
+		static const int16_t dirs[] = { 0, 0, 0 };
+		setup(dirs);
+		own_us[0] = CM_US(60);
+		own_us[2] = CM_US(20);
+		cross_us[0][1] = 2 * CM_US(60);
+
+		CHECK(run_frame(&f));
+		CHECK_EQ(f.echo[0], SONAR_CM_TICKS(60));
+		CHECK(fall_at[1] != 0); // it did get an echo
+		CHECK_EQ(f.echo[1], SONAR_TIMEOUT);
+		CHECK_EQ(f.echo[2], SONAR_CM_TICKS(20));
+		CHECK_EQ(f.xtalk, 1 << 1);
+	}
+
+	// ..., but not by a sensor that can't hear it: 2 waits for 1, and gets
+	// its own echo when 0's second echo comes back
+	{
+		static const int16_t dirs[] = { 0, 90, 90 };
+		setup(dirs);
+		own_us[0] = 2500;
+		own_us[1] = CM_US(10);
+		own_us[2] = 1000;
+
+		CHECK(run_frame(&f));
+		CHECK_EQ(f.echo[0], 2500 * ECHO_TICKS_PER_US);
+		CHECK_EQ(f.echo[1], SONAR_CM_TICKS(10));
+		CHECK_EQ(f.echo[2], 1000 * ECHO_TICKS_PER_US);
+		CHECK_EQ(f.xtalk, 0);
+		CHECK(fall_at[0] < arm_at[2]);
+		CHECK_EQ(fall_at[2], fall_at[0] + 2500);
+	}
+
+	// ticks close together (caught up after the LEDs): the trigger pulse is still long enough
+	{
+		static const int16_t dirs[] = { 0, 0, 0 };
+		setup(dirs);
+
+		for (tick_handler(); !(PORTD & (1 << 3)); tick_handler()) {
+			now_us += 1000;
+		}
+
+		tick_handler(); // right after the one that raised it
+		CHECK(PORTD & (1 << 3));
+		CHECK_EQ(arm_at[0], 0);
+
+		now_us += 10;
+		tick_handler();
+		CHECK(!(PORTD & (1 << 3)));
+		CHECK_EQ(arm_at[0], now_us);
+	}
+
+	// an echo a wrap of Timer1 (32.8 ms) after another's second echo - the
+	// Timer1 times are the same, only the ms into the frame tell it apart
+	{
+		static const int16_t dirs[] = { 0, 0, 0 };
+		setup(dirs);
+		start_frame();
+
+		Sonar *y = &sonars[0];
+		Sonar *x = &sonars[2];
+
+		y->has_rx = true;
+		y->rx_fired = 1;
+		y->rx = 6000;
+		y->width = SONAR_CM_TICKS(10);
+		y->rx_ms = 3;
+
+		x->phase = SONAR_DONE;
+		x->order = 2;
+		x->rx = (uint16_t)(y->rx + y->width);
+		x->rx_ms = 3 + 33;
+		work.echo[2] = SONAR_CM_TICKS(40);
+
+		reject_xtalk();
+		CHECK_EQ(work.xtalk, 0);
+		CHECK_EQ(work.echo[2], SONAR_CM_TICKS(40));
+
+		// ..., and in the same wrap it's cross-talk
+		x->rx_ms = 4;
+		reject_xtalk();
+		CHECK_EQ(work.xtalk, 1 << 2);
+		CHECK_EQ(work.echo[2], SONAR_TIMEOUT);
+
+		running = false;
+	}
+
+	CHECK_EQ(sonar_missed_count(), 0);
+
+	return check_exit("sonar");
+}
@@ -0,0 +1,84 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <avr/io.h>
+
+#include "mock.h"
+#include "check.h"
+#include "lib/systick.h"
+
+//
+// Host test of the millisecond time base (lib/systick.c).
+//
+// Registers handlers up to the limit and runs the compare interrupt
+// by hand, with Timer2 at the compare value (on time) or moved on as if
+// interrupts had been off for a while (the ticks are caught up).
+//
+
+void TIMER2_COMPA_vect(void);
+
+static unsigned runs[SYSTICK_HANDLERS + 1];
+
+static void h0(void) { runs[0]++; }
+static void h1(void) { runs[1]++; }
+static void h2(void) { runs[2]++; }
+static void h3(void) { runs[3]++; }
+static void h4(void) { runs[4]++; }
+
+static void (*const handlers[])(void) = { h0, h1, h2, h3, h4 };
+
+_Static_assert(sizeof(handlers) / sizeof(handlers[0]) == SYSTICK_HANDLERS + 1, "one handler more than there's room for");
+
+
+int main(void)
+{
+	mock_reset();
+
+	for (uint8_t i = 0; i < SYSTICK_HANDLERS; i++) {
+		CHECK_EQ(systick_add(handlers[i]), i);
+	}
+
+	// full - refused, and never called
+	CHECK_EQ(systick_add(handlers[SYSTICK_HANDLERS]), SYSTICK_NONE);
+
+	systick_init();
+
+	// on time, for several wraps of the timer - the compare value doesn't drift
+	unsigned wrong_ocr = 0;
+	for (uint16_t t = 0; t < 1000; t++) {
+		TCNT2 = OCR2A;
+		TIMER2_COMPA_vect();
+
+		if (OCR2A != (uint8_t)((uint16_t)(SYSTICK_STEP * (t + 2UL)) >> 8)) {
+			wrong_ocr++;
+		}
+	}
+	CHECK_EQ(wrong_ocr, 0);
+
+	for (uint8_t i = 0; i < SYSTICK_HANDLERS; i++) {
+		CHECK_EQ(runs[i], 1000);
+	}
+	CHECK_EQ(runs[SYSTICK_HANDLERS], 0);
+	CHECK_EQ(systick_ms(), 1000);
+
+	// late by 9 ms, and by the most it catches up on: the due tick and the missed ones
+	static const uint8_t late_ms[] = { 9, SYSTICK_CATCHUP_MS };
+
+	for (uint8_t k = 0; k < 2; k++) {
+		uint16_t ms = systick_ms();
+
+		TCNT2 = (uint8_t)(OCR2A + (late_ms[k] * (uint32_t) SYSTICK_STEP) / 256);
+		TIMER2_COMPA_vect();
+
+		CHECK_EQ(systick_ms() - ms, late_ms[k] + 1);
+		CHECK_EQ(runs[0], systick_ms());
+
+		// the next match is ahead
+		uint8_t ahead = (uint8_t)(OCR2A - TCNT2);
+		CHECK(ahead >= 2 && ahead <= SYSTICK_STEP_CNT + 1);
+	}
+
+	CHECK_EQ(SYSTICK_CATCHUP_MS, 15); // at 16 MHz
+
+	return check_exit("systick");
+}
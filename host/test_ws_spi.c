@@ -0,0 +1,130 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include <avr/io.h>
+
+#include "mock.h"
+#include "check.h"
+#include "lib/spi.h"
+#include "ws2812.h"
+
+//
+// Host test of the SPI backend of the LED driver (ws2812.c, WS_BACKEND_SPI).
+//
+// The SPI is replaced by a recorder. Each recorded byte is turned back
+// into a pulse (the leading ones at F_CPU/2) and checked against the
+// WS2812B timing, then the pulses are decoded back into colors.
+//
+
+/** Pulse widths from the datasheet, +- 150 ns */
+#define T0H_NS 400
+#define T1H_NS 800
+#define TOL_NS 150
+
+/** Bit period, 1250 +- 600 ns */
+#define TBIT_MIN_NS 650
+#define TBIT_MAX_NS 1850
+
+/** SPI bit at F_CPU/2, ns */
+#define SPI_BIT_NS (2000000000.0 / F_CPU)
+
+static uint8_t sent[64];
+static uint8_t sent_n;
+
+void spi_init_master(enum SPI_order order, enum SPI_cpol cpol, enum SPI_cpha cpha, enum SPI_clk_div clkdiv)
+{
+	CHECK_EQ(order, SPI_MSB_FIRST);
+	CHECK_EQ(cpol, CPOL_0);
+	CHECK_EQ(cpha, CPHA_0);
+	CHECK_EQ(clkdiv, SPI_DIV_2);
+}
+
+uint8_t spi_send(uint8_t byte)
+{
+	if (sent_n < sizeof(sent)) {
+		sent[sent_n] = byte;
+	}
+	sent_n++;
+	return 0;
+}
+
+
+/** Number of leading ones, or -1 if the byte isn't a single pulse from the MSB */
+static int pulse_bits(uint8_t b)
+{
+	int n = 0;
+	while (n < 8 && (b & (0x80 >> n))) {
+		n++;
+	}
+	for (int i = n; i < 8; i++) {
+		if (b & (0x80 >> i)) {
+			return -1;
+		}
+	}
+	return n;
+}
+
+
+/** Decode 8 sent bytes (MSB first) into a data byte */
+static int decode_byte(const uint8_t *p)
+{
+	int v = 0;
+
+	for (uint8_t i = 0; i < 8; i++) {
+		double high = pulse_bits(p[i]) * SPI_BIT_NS;
+
+		if (high >= T0H_NS - TOL_NS && high <= T0H_NS + TOL_NS) {
+			v <<= 1;
+		} else if (high >= T1H_NS - TOL_NS && high <= T1H_NS + TOL_NS) {
+			v = (v << 1) | 1;
+		} else {
+			return -1;
+		}
+	}
+	return v;
+}
+
+
+int main(void)
+{
+	mock_reset();
+	ws_init();
+
+	// the timing of both bit values
+	sent_n = 0;
+	ws_send_rgb(0x00, 0xFF, 0x00);
+	CHECK_EQ(sent_n, 24);
+
+	int zero = pulse_bits(sent[8]);
+	int one = pulse_bits(sent[0]);
+	CHECK(zero > 0 && one > zero);
+	CHECK(zero * SPI_BIT_NS >= T0H_NS - TOL_NS && zero * SPI_BIT_NS <= T0H_NS + TOL_NS);
+	CHECK(one * SPI_BIT_NS >= T1H_NS - TOL_NS && one * SPI_BIT_NS <= T1H_NS + TOL_NS);
+	CHECK(8 * SPI_BIT_NS >= TBIT_MIN_NS && 8 * SPI_BIT_NS <= TBIT_MAX_NS);
+
+	// every value on every channel comes back, in the GRB order
+	unsigned bad = 0;
+	for (unsigned v = 0; v < 256; v++) {
+		uint8_t r = (uint8_t) v;
+		uint8_t g = (uint8_t)(v * 7 + 3);
+		uint8_t b = (uint8_t)(255 - v);
+
+		sent_n = 0;
+		ws_send_rgb(r, g, b);
+
+		if (sent_n != 24 || decode_byte(sent) != g || decode_byte(sent + 8) != r || decode_byte(sent + 16) != b) {
+			bad++;
+		}
+	}
+	CHECK_EQ(bad, 0);
+
+	// interrupts stay on during a frame
+	SREG = _BV(SREG_I);
+	ws_begin();
+	ws_send_rgb(1, 2, 3);
+	CHECK(SREG & _BV(SREG_I));
+	ws_show();
+	CHECK(SREG & _BV(SREG_I));
+
+	return check_exit("ws_spi");
+}
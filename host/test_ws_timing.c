@@ -0,0 +1,210 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "check.h"
+#include "ws2812_timing.h"
+
+//
+// Host test of the WS2812 bit timing (ws2812_timing.h).
+//
+// The bit loops of the bit-bang and parallel backends are run in
+// a cycle-by-cycle model of the AVR instructions they're made of, for
+// several CPU frequencies. The pulse widths on a pin are compared with the
+// datasheet, and with what the macros say they are (the driver's static
+// asserts rely on them). The parallel loop is too slow for 8 MHz, the
+// macros must say so.
+//
+
+/** Instructions of the loops */
+typedef enum {
+	OP_OUT_HI,
+	OP_OUT_LO,
+	OP_NOP,
+	OP_SBRS,  // skip the next instruction if bit 7 of the data is set
+	OP_LSL,
+	OP_DEC,
+	OP_BRNE,  // back to the start of the loop
+	OP_LD,    // load the next slot (takes the next data bit, parallel)
+	OP_OR,
+	OP_OUT_D, // out the slot - low if the data bit is '0'
+} Op;
+
+/** Loop program */
+typedef struct {
+	Op ops[128];
+	uint8_t n;
+} Prog;
+
+static void emit(Prog *p, Op op, long count)
+{
+	for (long i = 0; i < count; i++) {
+		p->ops[p->n++] = op;
+	}
+}
+
+/** Bit-bang loop of ws_send_byte() */
+static void prog_bitbang(Prog *p, long f)
+{
+	p->n = 0;
+	emit(p, OP_OUT_HI, 1);
+	emit(p, OP_NOP, WS_BB_W1(f));
+	emit(p, OP_SBRS, 1);
+	emit(p, OP_OUT_LO, 1);
+	emit(p, OP_LSL, 1);
+	emit(p, OP_NOP, WS_BB_W2(f));
+	emit(p, OP_OUT_LO, 1);
+	emit(p, OP_NOP, WS_BB_W3(f));
+	emit(p, OP_DEC, 1);
+	emit(p, OP_BRNE, 1);
+}
+
+/** Bit loop of ws_par_send() */
+static void prog_parallel(Prog *p, long f)
+{
+	p->n = 0;
+	emit(p, OP_LD, 1);
+	emit(p, OP_OR, 1);
+	emit(p, OP_OUT_HI, 1);
+	emit(p, OP_NOP, WS_PAR_W1(f));
+	emit(p, OP_OUT_D, 1);
+	emit(p, OP_NOP, WS_PAR_W2(f));
+	emit(p, OP_OUT_LO, 1);
+	emit(p, OP_NOP, WS_PAR_W3(f));
+	emit(p, OP_DEC, 1);
+	emit(p, OP_BRNE, 1);
+}
+
+/** Pin edges of one byte: time of each rising and falling edge, cycles */
+typedef struct {
+	long rise[8];
+	long fall[8];
+} Trace;
+
+/** Run a loop for one data byte */
+static void run(const Prog *p, uint8_t data, Trace *tr)
+{
+	long t = 0;
+	uint8_t cnt = 8;
+	bool level = false;
+	bool slot = false; // data bit loaded by OP_LD
+	uint8_t bit = 0;
+	uint8_t pc = 0;
+
+	while (true) {
+		Op op = p->ops[pc++];
+
+		switch (op) {
+			case OP_OUT_HI:
+			case OP_OUT_LO:
+				t++;
+				if (op == OP_OUT_HI && !level) {
+					tr->rise[bit] = t;
+				} else if (op == OP_OUT_LO && level) {
+					tr->fall[bit] = t;
+				}
+				level = (op == OP_OUT_HI);
+				break;
+
+			case OP_SBRS:
+				t++;
+				if (data & 0x80) {
+					t++;
+					pc++;
+				}
+				break;
+
+			case OP_LSL:
+				t++;
+				data = (uint8_t)(data << 1);
+				break;
+
+			case OP_NOP:
+			case OP_OR:
+				t++;
+				break;
+
+			case OP_LD:
+				t += 2;
+				slot = data & 0x80;
+				data = (uint8_t)(data << 1);
+				break;
+
+			case OP_OUT_D:
+				t++;
+				if (!slot && level) {
+					tr->fall[bit] = t;
+					level = false;
+				}
+				break;
+
+			case OP_DEC:
+				t++;
+				cnt--;
+				break;
+
+			case OP_BRNE:
+				if (cnt == 0) {
+					return;
+				}
+				t += 2;
+				pc = 0;
+				bit++;
+				break;
+		}
+	}
+}
+
+
+/** Check a loop at one frequency */
+static void check_loop(const Prog *p, long f, long t0h, long t1h, long tbit)
+{
+	Trace tr;
+
+	// 0b01010011 - both values, and a change in both directions
+	run(p, 0x53, &tr);
+
+	for (uint8_t i = 0; i < 8; i++) {
+		bool one = (0x53 << i) & 0x80;
+		long high = tr.fall[i] - tr.rise[i];
+
+		CHECK_EQ(high, one ? t1h : t0h);
+		CHECK(WS_IN_SPEC(high, f, one ? WS_T1H_NS : WS_T0H_NS, WS_TOL_NS));
+
+		if (i < 7) {
+			// the low time after the last bit depends on the code around the loop
+			long period = tr.rise[i + 1] - tr.rise[i];
+			long low = tr.rise[i + 1] - tr.fall[i];
+
+			CHECK_EQ(period, tbit);
+			CHECK(WS_IN_SPEC(low, f, one ? WS_T1L_NS : WS_T0L_NS, WS_TOL_NS));
+			CHECK(WS_IN_SPEC(period, f, WS_TBIT_NS, WS_TBIT_TOL_NS));
+		}
+	}
+
+	CHECK(WS_TIMING_OK(t0h, t1h, tbit, f));
+}
+
+
+int main(void)
+{
+	static const long freqs[] = { 8000000L, 12000000L, 16000000L, 20000000L };
+	Prog p;
+
+	for (uint8_t i = 0; i < sizeof(freqs) / sizeof(freqs[0]); i++) {
+		long f = freqs[i];
+
+		prog_bitbang(&p, f);
+		check_loop(&p, f, WS_BB_T0H(f), WS_BB_T1H(f), WS_BB_TBIT(f));
+
+		if (f >= 12000000L) {
+			prog_parallel(&p, f);
+			check_loop(&p, f, WS_PAR_T0H(f), WS_PAR_T1H(f), WS_PAR_TBIT(f));
+		}
+	}
+
+	// 875 ns low after a '1' at 8 MHz - the driver refuses to build
+	CHECK(!WS_TIMING_OK(WS_PAR_T0H(8000000L), WS_PAR_T1H(8000000L), WS_PAR_TBIT(8000000L), 8000000L));
+	CHECK_EQ(WS_PAR_TBIT(8000000L) - WS_PAR_T1H(8000000L), 7);
+
+	return check_exit("ws_timing");
+}
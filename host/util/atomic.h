@@ -0,0 +1,10 @@
+#pragma once
+
+//
+// Host mock of <util/atomic.h> - the host build is single-threaded
+//
+
+#define ATOMIC_RESTORESTATE
+#define ATOMIC_FORCEON
+
+#define ATOMIC_BLOCK(type) for (uint8_t _atomic_once = 1; _atomic_once; _atomic_once = 0)
@@ -0,0 +1,17 @@
+#pragma once
+
+//
+// Host version of <util/crc16.h> (same algorithms as avr-libc)
+//
+
+#include <stdint.h>
+
+static inline uint16_t _crc_ccitt_update(uint16_t crc, uint8_t data)
+{
+	data ^= (uint8_t) crc;
+	data ^= (uint8_t)(data << 4);
+
+	return (uint16_t)((((uint16_t) data << 8) | (crc >> 8))
+	                  ^ (uint8_t)(data >> 4)
+	                  ^ ((uint16_t) data << 3));
+}
@@ -0,0 +1,10 @@
+#pragma once
+
+//
+// Host mock of <util/delay.h> - delays take no time
+//
+
+#include <util/delay_basic.h>
+
+static inline void _delay_ms(double ms) { (void) ms; }
+static inline void _delay_us(double us) { (void) us; }
@@ -0,0 +1,9 @@
+#pragma once
+
+//
+// Host mock of <util/delay_basic.h>
+//
+
+#include <stdint.h>
+
+#define __builtin_avr_delay_cycles(c) ((void)(c))
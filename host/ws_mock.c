@@ -0,0 +1,53 @@
+#include <stdint.h>
+
+#include "ws2812.h"
+#include "mock.h"
+
+// Host replacement of ws2812.c - counts and checksums the sent bytes
+
+
+static inline void ws_mock_byte(uint8_t b)
+{
+	mock_ws_bytes++;
+	mock_ws_sum = mock_ws_sum * 31 + b;
+}
+
+
+/** Init the output pin / peripheral */
+void ws_init(void)
+{
+}
+
+
+/** Start sending a frame */
+void ws_begin(void)
+{
+}
+
+
+/** Send a RGB color to the strip */
+void ws_send_rgb(uint8_t r, uint8_t g, uint8_t b)
+{
+	ws_mock_byte(g);
+	ws_mock_byte(r);
+	ws_mock_byte(b);
+}
+
+
+#if WS_BACKEND == WS_BACKEND_PARALLEL
+
+/** Send one LED position to all strips */
+void ws_par_send(const uint8_t *slots)
+{
+	for (uint8_t i = 0; i < WS_SLOTS; i++) {
+		ws_mock_byte(slots[i]);
+	}
+}
+
+#endif
+
+
+/** End the frame, wait long enough for the colors to show */
+void ws_show(void)
+{
+}
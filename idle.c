@@ -0,0 +1,40 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/sleep.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lib/echo.h"
+#include "idle.h"
+
+/** Time asleep, Timer1 ticks */
+static uint32_t slept = 0;
+
+
+/** Sleep until an interrupt */
+void idle_sleep(void)
+{
+	set_sleep_mode(SLEEP_MODE_IDLE);
+	sleep_enable();
+
+	// the systick wakes us every ms, the difference can't overflow
+	uint16_t t0 = echo_now();
+
+	// the instruction after sei always runs, so a pending interrupt
+	// can't slip in between and leave us asleep
+	sei();
+	sleep_cpu();
+	sleep_disable();
+
+	slept += (uint16_t)(echo_now() - t0);
+}
+
+
+/** Time asleep since the last call */
+uint32_t idle_take_slept_us(void)
+{
+	uint32_t ticks = slept;
+	slept = 0;
+
+	return ticks / ECHO_TICKS_PER_US;
+}
@@ -0,0 +1,39 @@
+#pragma once
+
+//
+//  IDLE sleep between events.
+//
+//  The main loop does all pending work, then checks with interrupts
+//  disabled that nothing new came in and calls idle_sleep(). Any
+//  interrupt wakes it up - echo edges, the systick, the USART. A LED
+//  refresh that can't be sent yet (an echo is being timed) doesn't keep
+//  it awake:
+//
+//    cli();
+//    if (!sonar_ready() && !(render_ready() && led_can_refresh())) {
+//        idle_sleep();
+//    }
+//    sei();
+//
+//  In IDLE the timers keep running and an interrupt only takes 4 more
+//  cycles to start when it wakes the CPU up - less than one Timer1 tick,
+//  and the input capture is latched by hardware anyway, so the echo
+//  timing is not affected.
+//
+//  The time spent asleep is measured on Timer1 (see lib/echo.h).
+//  It includes the interrupt that woke the CPU up.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Print the time awake per frame every second, 0 = off */
+#ifndef IDLE_REPORT
+#define IDLE_REPORT 0
+#endif
+
+/** Sleep until an interrupt. Call with interrupts disabled; it enables them. */
+void idle_sleep(void);
+
+/** Time asleep since the last call, us */
+uint32_t idle_take_slept_us(void);
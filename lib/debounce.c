@@ -7,53 +7,105 @@
 #include "debounce.h"
 #include "calc.h"
 #include "iopins.h"
+#include "systick.h"
 
-#include "lib/usart.h"
+_Static_assert(DEBO_TICKS < 255, "DEBO_TICKS must be under 255");
 
 DeboSlot debo_slots[DEBO_CHANNELS];
 
+DeboPort debo_ports[DEBO_PORTS] = {
+	{ &PINB, 0, 0, {0} },
+	{ &PINC, 0, 0, {0} },
+	{ &PIND, 0, 0, {0} },
+};
+
 /** Debounce data array */
 static uint8_t debo_next_slot = 0;
 
 uint8_t debo_add_do(PORT_P pin_ptr, uint8_t bit, bool invert, void (*handler)(uint8_t, bool))
 {
+	if (debo_next_slot >= DEBO_CHANNELS) {
+		return DEBO_NONE;
+	}
+
+	uint8_t p = 0;
+	while (p < DEBO_PORTS && debo_ports[p].reg != pin_ptr) {
+		p++;
+	}
+
+	if (p == DEBO_PORTS) {
+		return DEBO_NONE; // not a PINx register
+	}
+
 	DeboSlot *slot = &debo_slots[debo_next_slot];
+	DeboPort *port = &debo_ports[p];
 
-	slot->reg = pin_ptr;
+	slot->port = p;
 	slot->mask = (uint8_t)(1 << bit);
 	slot->invert = invert;
-	slot->count = 0;
-	slot->state = (*slot->reg & slot->mask);
 	slot->handler = handler;
 
+	port->mask |= slot->mask;
+	port->state = (uint8_t)((port->state & ~slot->mask) | (*pin_ptr & slot->mask));
+
 	return debo_next_slot++;
 }
 
 
-/** Check debounced pins, should be called periodically. */
-void debo_tick(void)
+/** Run debo_tick() from the systick interrupt */
+void debo_init(void)
+{
+	systick_add(debo_tick);
+}
+
+
+/** Call the handlers of pins that changed */
+static void debo_notify(uint8_t p, uint8_t changed)
 {
 	for (uint8_t i = 0; i < debo_next_slot; i++) {
 		DeboSlot *slot = &debo_slots[i];
 
-		// current pin value (right 3 bits, xored with inverse bit)
-		bool state = (*slot->reg & slot->mask);
-
-		if (state != slot->state) {
-			// different pin state than last recorded state
-			if (slot->count < DEBO_TICKS) {
-				slot->count++;
-			} else {
-				// overflown -> latch value
-				slot->state = state; // set state bit
-				slot->count = 0;
-
-				if (slot->handler != NULL) {
-					slot->handler(i, slot->invert ^ state);
-				}
+		if (slot->port == p && (changed & slot->mask) && slot->handler != NULL) {
+			slot->handler(i, debo_get_pin(i));
+		}
+	}
+}
+
+
+/** Check debounced pins, should be called periodically. */
+void debo_tick(void)
+{
+	for (uint8_t p = 0; p < DEBO_PORTS; p++) {
+		DeboPort *port = &debo_ports[p];
+
+		if (port->mask == 0) {
+			continue;
+		}
+
+		// pins in a different state than the last recorded one
+		uint8_t diff = (*port->reg ^ port->state) & port->mask;
+
+		// count them up, reset the others
+		uint8_t carry = diff;
+		for (uint8_t k = 0; k < DEBO_BITS; k++) {
+			uint8_t c = port->cnt[k];
+			port->cnt[k] = (c ^ carry) & diff;
+			carry &= c;
+		}
+
+		// pins whose count reached DEBO_LATCH
+		uint8_t latch = diff;
+		for (uint8_t k = 0; k < DEBO_BITS; k++) {
+			latch &= (DEBO_LATCH & (1 << k)) ? port->cnt[k] : ~port->cnt[k];
+		}
+
+		if (latch) {
+			port->state ^= latch;
+			for (uint8_t k = 0; k < DEBO_BITS; k++) {
+				port->cnt[k] &= ~latch;
 			}
-		} else {
-			slot->count = 0;; // reset the counter
+
+			debo_notify(p, latch);
 		}
 	}
 }
@@ -5,26 +5,34 @@
 //
 //  ----
 //
-//  You must provide a config file debo_config.h (next to your main.c)
-//
 //  A pin is registered like this:
 //
 //    #define BTN1 12 // pin D12
 //    #define BTN2 13
 //
-//    debo_add(BTN0);  // The function returns number assigned to the pin (0, 1, ...)
-//    debo_add_rev(BTN1);  // active low
-//    debo_register(&PINB, PB2, 0);  // direct access - register, pin & invert
+//    debo_add(BTN1, false, NULL);  // The function returns number assigned to the pin (0, 1, ...)
+//    debo_add(BTN2, true, my_handler);  // active low, my_handler(n, state) is called on changes
+//    debo_add_do(&PINB, PB2, false, NULL);  // direct access - register, pin, invert & handler
 //
-//  Then periodically call the tick function (perhaps in a timer interrupt):
+//  Then start the tick in the systick interrupt (or call debo_tick()
+//  periodically yourself):
 //
-//    debo_tick();
+//    debo_init();    // before systick_init()
 //
 //  To check if input is active, use
 //
 //    debo_get_pin(0); // state of input #0 (registered first)
 //    debo_get_pin(1); // state of input #1 (registered second)
 //
+//  The pins are debounced a whole port at a time, with vertical counters:
+//  bit k of the count of each pin is in byte cnt[k], so counting for all
+//  8 pins of a port takes the same few byte operations as for one.
+//  A tick costs the same for 1 and 8 pins on a port; the slots are only
+//  visited to call the handlers, when a pin changes.
+//
+//  The handlers are called from the tick, with debo_init() in the
+//  interrupt - keep them short.
+//
 
 
 #include <avr/io.h>
@@ -35,30 +43,58 @@
 #include "iopins.h"
 
 #define DEBO_CHANNELS 11
+
+/** A pin must differ for more than this many ticks to change */
 #define DEBO_TICKS 20
 
+/** Ports that can be debounced: PINB, PINC, PIND */
+#define DEBO_PORTS 3
+
+/** Returned by debo_add() when all channels are taken, or for another register */
+#define DEBO_NONE 0xFF
+
+/** Count at which a change is latched */
+#define DEBO_LATCH (DEBO_TICKS + 1)
+
+/** Bits of the vertical counter */
+#define DEBO_BITS \
+	(DEBO_LATCH < 2 ? 1 : DEBO_LATCH < 4 ? 2 : DEBO_LATCH < 8 ? 3 : DEBO_LATCH < 16 ? 4 : \
+	 DEBO_LATCH < 32 ? 5 : DEBO_LATCH < 64 ? 6 : DEBO_LATCH < 128 ? 7 : 8)
+
+
+/* Debounced port */
+typedef struct
+{
+	PORT_P reg;     // pin register
+	uint8_t mask;   // pins in use
+	uint8_t state;  // debounced pin values
+	uint8_t cnt[DEBO_BITS]; // vertical counter - ticks each pin was in the new state
+} DeboPort;
 
 /* Internal deboucer entry */
 typedef struct
 {
-	PORT_P reg;    // pin ptr
+	uint8_t port;  // index in debo_ports
 	uint8_t mask;
-	uint8_t count; // number of ticks this was in the new state
 	bool invert;
-	bool state;
 	void (*handler)(uint8_t pin_n, bool state);
 } DeboSlot;
 
 extern DeboSlot debo_slots[DEBO_CHANNELS];
+extern DeboPort debo_ports[DEBO_PORTS];
 
 /** Add a pin for debouncing (must be used with constant args) */
 #define debo_add(pin, reverse, hdlr) debo_add_do(&_pin(pin), _pn(pin), reverse, hdlr)
 
-/** Add a pin for debouncing (low level function) */
+/** Add a pin for debouncing (low level function). Returns DEBO_NONE on failure. */
 uint8_t debo_add_do(PORT_P pin_reg_pointer, uint8_t bit, bool invert, void (*handler)(uint8_t, bool));
 
+/** Run debo_tick() from the systick interrupt. Call before systick_init(). */
+void debo_init(void);
+
 /** Check debounced pins, should be called periodically. */
 void debo_tick(void);
 
 /** Get a value of debounced pin */
-#define debo_get_pin(i) (debo_slots[i].state ^ debo_slots[i].invert)
+#define debo_get_pin(i) \
+	(((debo_ports[debo_slots[i].port].state & debo_slots[i].mask) != 0) ^ debo_slots[i].invert)
@@ -0,0 +1,172 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "calc.h"
+#include "iopins.h"
+#include "echo.h"
+
+EchoChannel echo_channels[ECHO_CHANNELS];
+
+static uint8_t echo_next_slot = 0;
+
+/** Index of the channel using input capture, or 0xFF */
+static uint8_t echo_icp_ch = 0xFF;
+
+
+uint8_t echo_add_do(PORT_P pin_ptr, uint8_t bit)
+{
+	if (echo_next_slot >= ECHO_CHANNELS) {
+		return ECHO_NONE;
+	}
+
+	EchoChannel *chan = &echo_channels[echo_next_slot];
+
+	chan->reg = pin_ptr;
+	chan->mask = (uint8_t)(1 << bit);
+	chan->phase = ECHO_IDLE;
+	chan->icp = (pin_ptr == &PINB && bit == PB0);
+
+	if (chan->icp) {
+		echo_icp_ch = echo_next_slot;
+	} else if (pin_ptr == &PINB) {
+		PCMSK0 |= chan->mask;
+		PCICR |= (1 << PCIE0);
+	} else if (pin_ptr == &PINC) {
+		PCMSK1 |= chan->mask;
+		PCICR |= (1 << PCIE1);
+	} else {
+		PCMSK2 |= chan->mask;
+		PCICR |= (1 << PCIE2);
+	}
+
+	return echo_next_slot++;
+}
+
+
+/** Start Timer1 and enable the edge interrupts. */
+void echo_init(void)
+{
+	TCCR1A = 0;
+	TCCR1B = (1 << ICNC1) | (0b010 << CS10); // normal mode, clk/8, noise canceler
+	TIMSK1 = 0;
+}
+
+
+/** Current Timer1 time (atomic) */
+uint16_t echo_now(void)
+{
+	uint16_t t;
+	// TCNT1 reads go through the shared TEMP register
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		t = TCNT1;
+	}
+	return t;
+}
+
+
+/** Start waiting for an echo pulse on a channel */
+void echo_arm(uint8_t ch)
+{
+	EchoChannel *chan = &echo_channels[ch];
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		chan->phase = ECHO_WAIT_1;
+
+		if (chan->icp) {
+			sbi(TCCR1B, ICES1); // rising edge
+			TIFR1 = (1 << ICF1);
+			sbi(TIMSK1, ICIE1);
+		}
+	}
+}
+
+
+/** Stop waiting for an echo pulse */
+void echo_cancel(uint8_t ch)
+{
+	EchoChannel *chan = &echo_channels[ch];
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		chan->phase = ECHO_IDLE;
+
+		if (chan->icp) {
+			cbi(TIMSK1, ICIE1);
+		}
+	}
+}
+
+
+/** Advance a channel's state after its pin changed */
+static inline __attribute__((always_inline))
+void echo_edge(EchoChannel *chan, bool level, uint16_t t)
+{
+	if (chan->phase == ECHO_WAIT_1) {
+		if (level) {
+			// rising edge
+			chan->rise = t;
+			chan->phase = ECHO_WAIT_0;
+		}
+	} else if (chan->phase == ECHO_WAIT_0) {
+		if (!level) {
+			// falling edge, we're done
+			chan->width = t - chan->rise;
+			chan->phase = ECHO_DONE;
+		}
+	}
+}
+
+
+/** Handle a pin-change interrupt on one port */
+static inline __attribute__((always_inline))
+void echo_pcint(PORT_P pin_reg, uint16_t t)
+{
+	uint8_t pins = *pin_reg;
+
+	for (uint8_t i = 0; i < echo_next_slot; i++) {
+		EchoChannel *chan = &echo_channels[i];
+
+		if (chan->reg == pin_reg && !chan->icp) {
+			echo_edge(chan, pins & chan->mask, t);
+		}
+	}
+}
+
+
+ISR(TIMER1_CAPT_vect)
+{
+	uint16_t t = ICR1;
+	EchoChannel *chan = &echo_channels[echo_icp_ch];
+
+	if (chan->phase == ECHO_WAIT_1) {
+		chan->rise = t;
+		chan->phase = ECHO_WAIT_0;
+
+		// Changing the edge can set the flag, clear it
+		cbi(TCCR1B, ICES1);
+		TIFR1 = (1 << ICF1);
+	} else {
+		echo_edge(chan, false, t);
+		cbi(TIMSK1, ICIE1);
+	}
+}
+
+
+ISR(PCINT0_vect)
+{
+	echo_pcint(&PINB, TCNT1);
+}
+
+
+ISR(PCINT1_vect)
+{
+	echo_pcint(&PINC, TCNT1);
+}
+
+
+ISR(PCINT2_vect)
+{
+	echo_pcint(&PIND, TCNT1);
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+//
+//  Interrupt-driven echo pulse capture (for HC-SR04 style sonars).
+//
+//  Timer1 runs freely at F_CPU/8 (0.5 us per tick at 16 MHz) and the
+//  edges of the echo pulses are timestamped in interrupts:
+//
+//  - a channel on the ICP1 pin (D8) uses Timer1 input capture,
+//    so the timestamp is latched by hardware,
+//  - any other pin uses a pin-change interrupt and reads TCNT1
+//    at the start of the ISR.
+//
+//  Register the echo pins and start the timer:
+//
+//    uint8_t ch = echo_add(ECHO1_PIN);  // returns channel number (0, 1, ...), or ECHO_NONE
+//    echo_init();
+//    sei();
+//
+//  Then for each measurement:
+//
+//    echo_arm(ch);            // before the trigger pulse ends
+//    ...
+//    if (echo_ready(ch)) {
+//        uint16_t ticks = echo_width(ch);
+//    }
+//
+//  Timeouts are up to the caller - compare echo_now() with the time
+//  the channel was armed (or with echo_rise() for a pulse in progress),
+//  and call echo_cancel() when giving up.
+//
+
+#include <avr/io.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "calc.h"
+#include "iopins.h"
+
+/** Max number of echo channels (9 bytes of RAM each) - set it from the build */
+#ifndef ECHO_CHANNELS
+#define ECHO_CHANNELS 8
+#endif
+
+/** Returned by echo_add() when all channels are taken */
+#define ECHO_NONE 0xFF
+
+/** Timer1 ticks per microsecond */
+#define ECHO_TICKS_PER_US (F_CPU / 8000000UL)
+
+
+/** Phase of the capture (state-machine state) */
+typedef enum {
+	ECHO_IDLE,   // not measuring
+	ECHO_WAIT_1, // armed, waiting for rising edge
+	ECHO_WAIT_0, // pulse in progress, waiting for falling edge
+	ECHO_DONE    // width is valid
+} EchoPhase;
+
+
+/* Internal echo channel entry */
+typedef struct {
+	PORT_P reg;    // pin ptr
+	uint8_t mask;
+	bool icp;      // channel uses the Timer1 input capture unit
+	volatile EchoPhase phase;
+	volatile uint16_t rise; // timestamp of the rising edge
+	volatile uint16_t width; // pulse width in Timer1 ticks
+} EchoChannel;
+
+extern EchoChannel echo_channels[ECHO_CHANNELS];
+
+/** Add an echo input pin (must be used with constant args) */
+#define echo_add(pin) echo_add_do(&_pin(pin), _pn(pin))
+
+/** Add an echo input pin (low level function). Returns ECHO_NONE if there's no free channel. */
+uint8_t echo_add_do(PORT_P pin_reg_pointer, uint8_t bit);
+
+/** Start Timer1 and enable the edge interrupts. Call after all echo_add()s. */
+void echo_init(void);
+
+/** Current Timer1 time (atomic) */
+uint16_t echo_now(void);
+
+/** Start waiting for an echo pulse on a channel */
+void echo_arm(uint8_t ch);
+
+/** Stop waiting for an echo pulse (eg. on timeout) */
+void echo_cancel(uint8_t ch);
+
+/** Check if the channel has a finished pulse */
+#define echo_ready(ch) (echo_channels[ch].phase == ECHO_DONE)
+
+/** Check if the channel is waiting for (or inside) a pulse */
+#define echo_busy(ch) (echo_channels[ch].phase == ECHO_WAIT_1 || echo_channels[ch].phase == ECHO_WAIT_0)
+
+/** Check if the channel is inside a pulse (the rising edge came) */
+#define echo_in_pulse(ch) (echo_channels[ch].phase == ECHO_WAIT_0)
+
+/** Get the rising edge time (valid when echo_in_pulse()) */
+#define echo_rise(ch) (echo_channels[ch].rise)
+
+/** Get the measured pulse width (valid when echo_ready()) */
+#define echo_width(ch) (echo_channels[ch].width)
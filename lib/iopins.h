@@ -7,9 +7,24 @@
 //
 // If you know the pin number beforehand, you can use the macros.
 //
-// If you need to use a variable for pin number, use the `_n` functions.
-// They are much slower, so always check if you really need them
-// - and they aren't fit for things where precise timing is required.
+// If you need to use a variable for pin number, resolve it to a pin handle
+// once with pin_handle(), and then use the `_h` functions - those are
+// inline and compile to a few loads and a store:
+//
+//   PinHandle trig = pin_handle(n);
+//   as_output_h(&trig);
+//   pin_up_h(&trig);
+//
+// The `_n` functions take the pin number directly and look it up every
+// time, so they are slower - fine for setup, not for tight loops.
+// Like the constant-pin macros (single sbi/cbi), they are safe to use
+// when an interrupt changes the same port - the read-modify-write is
+// done with interrupts disabled.
+//
+// The `_h` functions write the registers with a read-modify-write too,
+// but don't disable interrupts. If an interrupt changes the same port,
+// call them with interrupts disabled (or from the ISR).
+// pin_toggle_h() is the exception, it's a plain write to PINx.
 //
 
 #include <avr/io.h>
@@ -23,6 +38,21 @@
 typedef volatile uint8_t* PORT_P;
 
 
+/** Registers of a pin, for use with the `_h` functions */
+typedef struct {
+	PORT_P port;
+	PORT_P pin;
+	PORT_P ddr;
+	uint8_t mask;
+} PinHandle;
+
+/** Number of pins with a handle (D0..D21) */
+#define PIN_COUNT 22
+
+/** Resolve a pin number to a handle. Invalid pins give a handle that does nothing. */
+PinHandle pin_handle(uint8_t pin);
+
+
 /** Pin numbering reference */
 #define D0 0
 #define D1 1
@@ -65,56 +95,73 @@ typedef volatile uint8_t* PORT_P;
 /** Set pin direction */
 #define set_dir(pin, d)  set_bit( _ddr(pin), _pn(pin), d )
 void    set_dir_n(const uint8_t pin, const uint8_t d);
+static inline void set_dir_h(const PinHandle *h, uint8_t d)
+{
+	if (d) *h->ddr |= h->mask; else *h->ddr &= ~h->mask;
+}
 
 
 /** Configure pin as input */
 #define as_input(pin)    cbi( _ddr(pin), _pn(pin) )
 void    as_input_n(const uint8_t pin);
+static inline void as_input_h(const PinHandle *h) { *h->ddr &= ~h->mask; }
 
 
 /** Configure pin as input, with pull-up enabled */
 #define as_input_pu(pin) { as_input(pin); pin_up(pin); }
 void    as_input_pu_n(const uint8_t pin);
+static inline void as_input_pu_h(const PinHandle *h) { *h->ddr &= ~h->mask; *h->port |= h->mask; }
 
 
 /** Configure pin as output */
 #define as_output(pin)   sbi( _ddr(pin), _pn(pin) )
 void    as_output_n(const uint8_t pin);
+static inline void as_output_h(const PinHandle *h) { *h->ddr |= h->mask; }
 
 
 /** Write value to a pin */
 #define pin_set(pin, v) set_bit( _port(pin), _pn(pin), v )
 void    pin_set_n(const uint8_t pin, const uint8_t v);
+static inline void pin_set_h(const PinHandle *h, uint8_t v)
+{
+	if (v) *h->port |= h->mask; else *h->port &= ~h->mask;
+}
 
 
 /** Write 0 to a pin */
 #define pin_down(pin)    cbi( _port(pin), _pn(pin) )
 void    pin_down_n(const uint8_t pin);
+static inline void pin_down_h(const PinHandle *h) { *h->port &= ~h->mask; }
 
 
 /** Write 1 to a pin */
 #define pin_up(pin)   sbi( _port(pin), _pn(pin) )
 void    pin_up_n(uint8_t pin);
+static inline void pin_up_h(const PinHandle *h) { *h->port |= h->mask; }
 
 
 /** Toggle a pin state */
 #define pin_toggle(pin)   sbi( _pin(pin), _pn(pin) )
 void    pin_toggle_n(uint8_t pin);
+static inline void pin_toggle_h(const PinHandle *h) { *h->pin = h->mask; }
 
 
 /** Read a pin value */
 #define pin_read(pin)  get_bit( _pin(pin), _pn(pin) )
 bool    pin_read_n(uint8_t pin);
+static inline bool pin_read_h(const PinHandle *h) { return (*h->pin & h->mask) != 0; }
 
 
 /** CHeck if pin is low */
 #define pin_is_low(pin)   (pin_read(pin) == 0)
 bool    pin_is_low_n(uint8_t pin);
+static inline bool pin_is_low_h(const PinHandle *h) { return !pin_read_h(h); }
 
 
 /** CHeck if pin is high */
 #define pin_is_high(pin)  (pin_read(pin) != 0)
 bool    pin_is_high_n(uint8_t pin);
+static inline bool pin_is_high_h(const PinHandle *h) { return pin_read_h(h); }
 
 
 
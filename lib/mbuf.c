@@ -0,0 +1,31 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "calc.h"
+#include "mbuf.h"
+
+
+/** Get the current mean value */
+uint16_t mbuf_mean(const MBuf *buf)
+{
+	if (buf->shift != MBUF_NO_SHIFT) {
+		return (uint16_t)(buf->sum >> buf->shift);
+	}
+
+	return (uint16_t)(buf->sum / buf->len);
+}
+
+
+/** Add a value to the averaging buffer. Returns current mean value */
+uint16_t mbuf_add(MBuf *buf, uint16_t value)
+{
+	uint16_t *slot = &buf->data[buf->head];
+
+	buf->sum -= *slot;
+	buf->sum += value;
+	*slot = value;
+
+	inc_wrap(buf->head, 0, buf->len);
+
+	return mbuf_mean(buf);
+}
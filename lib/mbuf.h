@@ -0,0 +1,49 @@
+#pragma once
+
+//
+//  Moving average buffer with a running sum.
+//
+//  Adding a sample and getting the mean is O(1) regardless of the length:
+//  the oldest sample is subtracted from the sum and overwritten in place.
+//  For power-of-two lengths the division becomes a shift.
+//
+//  Values are 16-bit unsigned (eg. 8.8 fixed point), the length is 1..255.
+//
+//    MBUF_DEFINE(mb_foo, 16); // static buffer of 16 samples
+//
+//    uint16_t mean = mbuf_add(&mb_foo, value);
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "calc.h"
+
+/** Marks a length that is not a power of two */
+#define MBUF_NO_SHIFT 0xFF
+
+/** log2 of a power-of-two length (compile time), or MBUF_NO_SHIFT */
+#define MBUF_SHIFT(n) \
+	((n) == 1 ? 0 : (n) == 2 ? 1 : (n) == 4 ? 2 : (n) == 8 ? 3 : \
+	 (n) == 16 ? 4 : (n) == 32 ? 5 : (n) == 64 ? 6 : (n) == 128 ? 7 : \
+	 MBUF_NO_SHIFT)
+
+/** Averaging buffer instance */
+typedef struct {
+	uint16_t *data;
+	uint8_t len;
+	uint8_t head;   // slot of the oldest sample
+	uint8_t shift;  // log2(len) or MBUF_NO_SHIFT
+	uint32_t sum;   // sum of all samples in data
+} MBuf;
+
+/** Define a static averaging buffer (filled with zeros) */
+#define MBUF_DEFINE(name, length) \
+	static uint16_t name##_data[(length)]; \
+	static MBuf name = { name##_data, (length), 0, MBUF_SHIFT(length), 0 }
+
+/** Add a value to the averaging buffer. Returns current mean value */
+uint16_t mbuf_add(MBuf *buf, uint16_t value);
+
+/** Get the current mean value */
+uint16_t mbuf_mean(const MBuf *buf);
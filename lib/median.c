@@ -0,0 +1,81 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "calc.h"
+#include "median.h"
+
+
+/** Add a value to the window. Returns the median. */
+uint16_t medbuf_add(MedBuf *buf, uint16_t value)
+{
+	uint16_t *s = buf->sorted;
+	uint8_t last = (uint8_t)(buf->len - 1);
+
+	// swap the oldest sample for the new one in the ring
+	uint16_t old = buf->ring[buf->head];
+	buf->ring[buf->head] = value;
+	inc_wrap(buf->head, 0, buf->len);
+
+	// find the oldest sample in the sorted window (any of equal ones will do)
+	uint8_t i = 0;
+	while (s[i] != old) {
+		i++;
+	}
+
+	// overwrite it and move the new value into place
+	if (value > old) {
+		while (i < last && s[i + 1] < value) {
+			s[i] = s[i + 1];
+			i++;
+		}
+	} else {
+		while (i > 0 && s[i - 1] > value) {
+			s[i] = s[i - 1];
+			i--;
+		}
+	}
+	s[i] = value;
+
+	return medbuf_median(buf);
+}
+
+
+/** Get the median absolute deviation of the window */
+uint16_t medbuf_mad(const MedBuf *buf)
+{
+	const uint16_t *s = buf->sorted;
+	uint8_t mid = buf->len / 2;
+	uint16_t med = s[mid];
+
+	// The deviations grow outwards from the median on both sides,
+	// so their median is found by merging the two sides - mid steps.
+	int16_t lo = (int16_t) mid - 1;
+	uint8_t hi = (uint8_t)(mid + 1);
+	uint16_t dev = 0;
+
+	for (uint8_t n = 0; n < mid; n++) {
+		if (hi >= buf->len || (lo >= 0 && med - s[lo] <= s[hi] - med)) {
+			dev = med - s[lo--];
+		} else {
+			dev = s[hi++] - med;
+		}
+	}
+
+	return dev;
+}
+
+
+/** Add a value and return it, or the median if it's an outlier */
+uint16_t medbuf_hampel(MedBuf *buf, uint16_t value, uint8_t k, uint16_t min)
+{
+	uint16_t med = medbuf_add(buf, value);
+
+	uint32_t limit = ((uint32_t) medbuf_mad(buf) * k) >> 4;
+	if (limit < min) {
+		limit = min;
+	}
+
+	uint16_t dev = (value > med) ? value - med : med - value;
+
+	return (dev > limit) ? med : value;
+}
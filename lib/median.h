@@ -0,0 +1,62 @@
+#pragma once
+
+//
+//  Running median over a small window, for rejecting single-sample spikes.
+//
+//  The window is kept twice: in arrival order (a ring) and sorted.
+//  Adding a sample replaces the oldest one in the sorted copy and moves
+//  it into place - O(len) with no re-sorting, and the median is just the
+//  middle element.
+//
+//  The length must be odd (1..255), values are 16-bit unsigned.
+//
+//    MEDBUF_DEFINE(md_foo, 5); // static window of 5 samples
+//
+//    uint16_t median = medbuf_add(&md_foo, value);
+//
+//  Or as a Hampel filter - the sample passes unless it's too far from
+//  the median (k * 1.4826 * MAD, the median absolute deviation), then
+//  the median is used instead:
+//
+//    uint16_t out = medbuf_hampel(&md_foo, value, MEDBUF_HAMPEL_K(3), min);
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "calc.h"
+
+/** Median window instance */
+typedef struct {
+	uint16_t *ring;   // samples in arrival order
+	uint16_t *sorted; // the same samples, ascending
+	uint8_t len;
+	uint8_t head;     // ring slot of the oldest sample
+} MedBuf;
+
+/** Define a static median window (filled with zeros) */
+#define MEDBUF_DEFINE(name, length) \
+	_Static_assert((length) % 2 == 1 && (length) < 256, "median window length must be odd"); \
+	static uint16_t name##_ring[(length)]; \
+	static uint16_t name##_sorted[(length)]; \
+	static MedBuf name = { name##_ring, name##_sorted, (length), 0 }
+
+/** Hampel threshold factor for k standard deviations (k * 1.4826), 4.4 fixed point */
+#define MEDBUF_HAMPEL_K(k) ((uint8_t)((k) * 1.4826 * 16 + 0.5))
+
+/** Add a value to the window. Returns the median. */
+uint16_t medbuf_add(MedBuf *buf, uint16_t value);
+
+/** Get the current median */
+#define medbuf_median(buf) ((buf)->sorted[(buf)->len / 2])
+
+/** Get the median absolute deviation of the window */
+uint16_t medbuf_mad(const MedBuf *buf);
+
+/**
+ * Add a value and return it, or the median if it's an outlier
+ *
+ * k: threshold factor, see MEDBUF_HAMPEL_K()
+ * min: lowest threshold (MAD is 0 when most samples are equal)
+ */
+uint16_t medbuf_hampel(MedBuf *buf, uint16_t value, uint8_t k, uint16_t min);
@@ -8,8 +8,11 @@
 #include <util/delay_basic.h>
 #include <stdint.h>
 
-/* Convert nanoseconds to cycle count */
-#define ns2cycles(ns)  ( (ns) / (1000000000L / (signed long) F_CPU) )
+/* Convert nanoseconds to cycle count (rounded to nearest) */
+#define ns2cycles(ns)  ( ((ns) * (signed long long) F_CPU + 500000000LL) / 1000000000LL )
+
+/* Convert cycle count to nanoseconds (rounded down) */
+#define cycles2ns(c)  ( (c) * 1000000000LL / (signed long long) F_CPU )
 
 /** Wait c cycles */
 #define delay_c(c)  (((c) > 0) ? __builtin_avr_delay_cycles(c) :  __builtin_avr_delay_cycles(0))
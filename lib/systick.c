@@ -0,0 +1,74 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/atomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "calc.h"
+#include "systick.h"
+
+static void (*systick_handlers[SYSTICK_HANDLERS])(void);
+static uint8_t systick_next_slot = 0;
+
+static volatile uint16_t systick_count = 0;
+
+/** Timer2 time of the next tick, 8.8 fixed point (wraps with the timer) */
+static uint16_t systick_due;
+
+
+/** Register a function to be called every tick */
+uint8_t systick_add(void (*handler)(void))
+{
+	if (systick_next_slot >= SYSTICK_HANDLERS) {
+		return SYSTICK_NONE;
+	}
+
+	systick_handlers[systick_next_slot] = handler;
+	return systick_next_slot++;
+}
+
+
+/** Start Timer2 */
+void systick_init(void)
+{
+	TCCR2A = 0; // normal mode, runs through 0..255
+	TCCR2B = (0b111 << CS20); // clk/1024
+	TCNT2 = 0;
+	systick_due = SYSTICK_STEP;
+	OCR2A = (uint8_t)(systick_due >> 8);
+	sbi(TIMSK2, OCIE2A);
+}
+
+
+/** Milliseconds since start */
+uint16_t systick_ms(void)
+{
+	uint16_t t;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		t = systick_count;
+	}
+	return t;
+}
+
+
+ISR(TIMER2_COMPA_vect)
+{
+	uint8_t ahead;
+
+	// Run the tick that's due, and the ones missed while interrupts were off.
+	// The next one must be at least 2 counts ahead - one could pass before
+	// OCR2A is written, and the match would come a whole wrap late.
+	do {
+		systick_count++;
+
+		for (uint8_t i = 0; i < systick_next_slot; i++) {
+			systick_handlers[i]();
+		}
+
+		systick_due += SYSTICK_STEP;
+		ahead = (uint8_t)((uint8_t)(systick_due >> 8) - TCNT2);
+	} while (ahead < 2 || ahead > SYSTICK_STEP_CNT + 1);
+
+	OCR2A = (uint8_t)(systick_due >> 8);
+}
@@ -0,0 +1,65 @@
+#pragma once
+
+//
+//  Millisecond time base on Timer2.
+//
+//  Timer2 runs freely at clk/1024 and fires an interrupt every 1 ms (its
+//  compare value is moved on by 1 ms each time, to within one count -
+//  64 us at 16 MHz). Functions registered with systick_add() are called
+//  from the interrupt, so they must be short. There's room for
+//  SYSTICK_HANDLERS of them.
+//
+//  If interrupts were off for longer than a ms (the CPU-timed LED
+//  backends send a whole frame that way), the interrupt runs the ticks
+//  it missed one after another, so no ms is lost - as long as it was
+//  off for less than SYSTICK_CATCHUP_MS. The handlers then see the
+//  ticks late and close together.
+//
+//    systick_add(my_handler);
+//    systick_init();
+//    sei();
+//
+//    uint16_t t = systick_ms(); // wraps every ~65 s, use differences
+//
+
+#include <avr/io.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "calc.h"
+
+/** Max number of tick handlers */
+#ifndef SYSTICK_HANDLERS
+#define SYSTICK_HANDLERS 4
+#endif
+
+/** Returned by systick_add() when all handler slots are taken */
+#define SYSTICK_NONE 0xFF
+
+/** Timer2 counts per ms with clk/1024, 8.8 fixed point (exact for 8, 12, 16 and 20 MHz) */
+#define SYSTICK_STEP (F_CPU / 4000)
+
+/** ..., rounded up to whole counts */
+#define SYSTICK_STEP_CNT ((SYSTICK_STEP + 255) / 256)
+
+#if SYSTICK_STEP_CNT > 64
+#error "F_CPU too high for the Timer2 systick"
+#endif
+
+/**
+ * Longest time with interrupts off that the systick catches up on, ms
+ *
+ * Timer2 wraps after 256 counts; a compare value up to SYSTICK_STEP_CNT + 1
+ * counts ahead is taken as the next tick, anything else as missed ticks.
+ * 15 ms at 16 MHz.
+ */
+#define SYSTICK_CATCHUP_MS ((254UL - SYSTICK_STEP_CNT) * 1024 * 1000 / F_CPU)
+
+/** Register a function to be called every tick (from the ISR). Returns SYSTICK_NONE if there's no free slot. */
+uint8_t systick_add(void (*handler)(void));
+
+/** Start Timer2 */
+void systick_init(void);
+
+/** Milliseconds since start (atomic) */
+uint16_t systick_ms(void);
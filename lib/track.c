@@ -0,0 +1,51 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "track.h"
+
+/** Limit of the rate, per step */
+#define TRACK_VEL_MAX (0xFFFFL << TRACK_FRAC)
+
+
+/** Add a sample */
+void track_update(Track *tr, uint16_t value, uint8_t alpha, uint8_t beta)
+{
+	// predict this step
+	int32_t pos = tr->pos + tr->vel;
+
+	// correct by the error (about 21 bits, the products fit)
+	int32_t err = ((int32_t) value << TRACK_FRAC) - pos;
+
+	tr->pos = pos + ((err * alpha) >> 8);
+	tr->vel += (err * beta) >> 8;
+
+	// a change of more than the whole range per step is nonsense
+	if (tr->vel > TRACK_VEL_MAX) {
+		tr->vel = TRACK_VEL_MAX;
+	} else if (tr->vel < -TRACK_VEL_MAX) {
+		tr->vel = -TRACK_VEL_MAX;
+	}
+}
+
+
+/** Get the estimate ahead by lead steps */
+uint16_t track_predict(const Track *tr, uint16_t lead)
+{
+	// vel is within 20 bits, the lead within 10 - the product fits
+	if (lead > TRACK_LEAD_MAX) {
+		lead = TRACK_LEAD_MAX;
+	}
+
+	int32_t pos = tr->pos + ((tr->vel * (int32_t) lead) >> 8);
+
+	pos >>= TRACK_FRAC;
+
+	if (pos < 0) {
+		return 0;
+	}
+	if (pos > 0xFFFF) {
+		return 0xFFFF;
+	}
+
+	return (uint16_t) pos;
+}
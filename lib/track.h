@@ -0,0 +1,45 @@
+#pragma once
+
+//
+//  Alpha-beta tracker - estimates a value and its rate of change.
+//
+//  Each sample moves the prediction by alpha times the error, and the
+//  rate by beta times the error. Unlike a moving average, it follows a
+//  steady movement without lagging behind, and it can extrapolate ahead
+//  (eg. to the time the value is actually shown).
+//
+//  The samples are assumed to come at a fixed interval (one "step"),
+//  the rate is per step. Values are 16-bit unsigned (eg. 8.8 fixed
+//  point), alpha and beta are 0.8 fixed point (TRACK_COEF()).
+//
+//    static Track tr_foo; // zero-initialized
+//
+//    track_update(&tr_foo, value, TRACK_COEF(0.5), TRACK_COEF(0.17));
+//    uint16_t est = track_predict(&tr_foo, 256); // one step ahead, 8.8
+//
+//  For a critically damped response, beta = alpha^2 / (2 - alpha).
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Extra fraction bits of the state over the input values */
+#define TRACK_FRAC 4
+
+/** Alpha or beta coefficient, 0..1 -> 0.8 fixed point */
+#define TRACK_COEF(x) ((uint8_t)((x) * 256 + 0.5))
+
+/** Longest extrapolation, 8.8 fixed point (4 steps) */
+#define TRACK_LEAD_MAX (4 << 8)
+
+/** Tracker instance */
+typedef struct {
+	int32_t pos; // estimated value, TRACK_FRAC more fraction bits than the input
+	int32_t vel; // change per step, same units
+} Track;
+
+/** Add a sample (one step after the previous one) */
+void track_update(Track *tr, uint16_t value, uint8_t alpha, uint8_t beta);
+
+/** Get the estimate ahead by lead steps (8.8 fixed point, up to TRACK_LEAD_MAX), clamped to 0..0xFFFF */
+uint16_t track_predict(const Track *tr, uint16_t lead);
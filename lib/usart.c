@@ -1,14 +1,27 @@
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include <avr/pgmspace.h>
 #include <util/delay.h>
 
 #include <stdbool.h>
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "calc.h"
 #include "usart.h"
 
+#define TX_MASK (USART_TX_BUF_LEN - 1)
+
+#if (USART_TX_BUF_LEN & TX_MASK) != 0 || USART_TX_BUF_LEN > 128
+#error "USART_TX_BUF_LEN must be a power of two, max 128"
+#endif
+
+/** TX ring buffer. head is written by usart_try_XXX, tail by the ISR */
+static uint8_t tx_buf[USART_TX_BUF_LEN];
+static volatile uint8_t tx_head = 0;
+static volatile uint8_t tx_tail = 0;
+
 
 void usart_init(uint16_t ubrr)
 {
@@ -34,13 +47,92 @@ void usart_set_2x(bool set)
 }
 
 
+/** Number of free bytes in the TX buffer */
+uint8_t usart_tx_free(void)
+{
+	// one slot stays empty to tell full from empty
+	return (uint8_t)(TX_MASK - ((tx_head - tx_tail) & TX_MASK));
+}
+
+
+/** Send one byte from the buffer, if there's any */
+static inline __attribute__((always_inline))
+void tx_next(void)
+{
+	uint8_t tail = tx_tail;
+
+	if (tail == tx_head) {
+		usart_isr_dre_enable(false); // nothing more to send
+		return;
+	}
+
+	UDR0 = tx_buf[tail];
+	tx_tail = (tail + 1) & TX_MASK;
+}
+
+
+/** Queue a byte for sending */
+bool usart_try_tx(uint8_t data)
+{
+	if (usart_tx_free() == 0) {
+		return false;
+	}
+
+	uint8_t head = tx_head;
+	tx_buf[head] = data;
+	tx_head = (head + 1) & TX_MASK;
+
+	usart_isr_dre_enable(true);
+	return true;
+}
+
+
+/** Queue a block of bytes, all or nothing */
+bool usart_try_write(const uint8_t *data, uint8_t len)
+{
+	if (usart_tx_free() < len) {
+		return false;
+	}
+
+	uint8_t head = tx_head;
+	while (len--) {
+		tx_buf[head] = *data++;
+		head = (head + 1) & TX_MASK;
+	}
+	tx_head = head;
+
+	usart_isr_dre_enable(true);
+	return true;
+}
+
+
 /** Send byte over USART */
 void usart_tx(uint8_t data)
 {
-	// Wait for transmit buffer
-	while (!usart_tx_ready());
-	// send it
-	UDR0 = data;
+	// Wait for space in the buffer
+	while (!usart_try_tx(data)) {
+		if (bit_is_low(SREG, SREG_I) && usart_tx_ready()) {
+			// the ISR can't run, send a byte ourselves
+			tx_next();
+		}
+	}
+}
+
+
+/** Wait until all buffered data is sent */
+void usart_flush_tx(void)
+{
+	while (tx_head != tx_tail) {
+		if (bit_is_low(SREG, SREG_I) && usart_tx_ready()) {
+			tx_next();
+		}
+	}
+}
+
+
+ISR(USART_UDRE_vect)
+{
+	tx_next();
 }
 
 
@@ -73,6 +165,37 @@ void usart_puts_P(const char* str)
 }
 
 
+/** Queue a string, all or nothing */
+bool usart_try_puts(const char* str)
+{
+	size_t len = strlen(str);
+
+	if (len > 255) {
+		return false;
+	}
+
+	return usart_try_write((const uint8_t *) str, (uint8_t) len);
+}
+
+
+/** Queue a progmem string, all or nothing */
+bool usart_try_puts_P(const char* str)
+{
+	size_t len = strlen_P(str);
+
+	if (len > usart_tx_free()) {
+		return false;
+	}
+
+	char c;
+	while ((c = pgm_read_byte(str++))) {
+		usart_try_tx(c);
+	}
+
+	return true;
+}
+
+
 /** Clear receive buffer */
 void usart_flush_rx(void)
 {
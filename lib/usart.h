@@ -6,6 +6,14 @@
 // First, init uart with usart_init().
 // Then enable interrupts you want with usart_XXX_isr_enable().
 //
+// Transmit is buffered - bytes go to a ring buffer that is drained
+// by the DRE interrupt (enabled automatically). The blocking functions
+// wait for space in the buffer (and drain it themselves if interrupts
+// are disabled). The usart_try_XXX() functions never wait, they
+// return false when the data doesn't fit in the buffer.
+//
+// The TX functions must not be called from interrupts.
+//
 
 #include <avr/io.h>
 #include <avr/pgmspace.h>
@@ -16,6 +24,11 @@
 
 #include "calc.h"
 
+/** TX buffer size (power of two, max 128) */
+#ifndef USART_TX_BUF_LEN
+#define USART_TX_BUF_LEN 64
+#endif
+
 
 /* USART BAUD RATE REGISTER values at 16 MHz */
 enum {
@@ -64,10 +77,26 @@ void usart_set_2x(bool set);
 
 // ---- Basic IO --------------------------
 
-/** Send byte over USART */
+/** Send byte over USART (waits for space in the buffer) */
 void usart_tx(uint8_t data);
 
 
+/** Queue a byte for sending. Returns false if the buffer is full. */
+bool usart_try_tx(uint8_t data);
+
+
+/** Queue a block of bytes, all or nothing. Returns false if it doesn't fit. */
+bool usart_try_write(const uint8_t *data, uint8_t len);
+
+
+/** Number of free bytes in the TX buffer */
+uint8_t usart_tx_free(void);
+
+
+/** Wait until all buffered data is sent */
+void usart_flush_tx(void);
+
+
 /** Receive one byte over USART */
 uint8_t usart_rx(void);
 
@@ -84,3 +113,11 @@ void usart_puts(const char* str);
 
 /** Send progmem string `PSTR("foobar")` over UART  */
 void usart_puts_P(const char* str);
+
+
+/** Queue a string, all or nothing. Returns false if it doesn't fit. */
+bool usart_try_puts(const char* str);
+
+
+/** Queue a progmem string, all or nothing. Returns false if it doesn't fit. */
+bool usart_try_puts_P(const char* str);
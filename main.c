@@ -1,4 +1,5 @@
 #include <avr/io.h>
+#include <avr/interrupt.h>
 #include <avr/pgmspace.h>
 #include <util/delay.h>
 
@@ -11,236 +12,102 @@
 #include "lib/iopins.h"
 #include "lib/usart.h"
 #include "lib/nsdelay.h"
+#include "lib/echo.h"
+#include "lib/systick.h"
+#include "sonar.h"
+#include "ws2812.h"
+#include "telemetry.h"
+#include "pipeline.h"
+#include "strip.h"
+#include "render.h"
+#include "prof.h"
+#include "idle.h"
 
 // --- Pin assignments  ---
 
-// RGB data
-#define WS_PIN 7
+// RGB data - see ws2812.h (WS_PIN, or MOSI with the SPI backend)
 
-// Sonars
-#define TRIG1_PIN 3
-#define ECHO1_PIN 2
+// Indicator LED, blinks once a second. With the SPI backend D13 is SCK.
+#define LED_PIN 13
+#define HAS_LED (WS_BACKEND != WS_BACKEND_SPI)
 
-#define TRIG2_PIN 9
-#define ECHO2_PIN 8
+// Sonars - see sensors.h
 
-#define TRIG3_PIN 11
-#define ECHO3_PIN 10
-
-
-/** Number of LEDs in your strip */
-#define LED_COUNT 30
-
-
-/** averaging buffer length (number of samples) */
-#define MBUF_LEN 16
-
-/** Phase of the measurement (state-machine state) */
-typedef enum {
-	MEAS_WAIT_1,
-	MEAS_WAIT_0,
-	MEAS_DONE
-} MeasPhase;
-
-/** Averaging buffer instance */
-typedef struct {
-	float data[MBUF_LEN];
-} MBuf;
-
-static MBuf mb_offs1;
-static MBuf mb_offs2;
-static MBuf mb_offs3;
-
-/** RGB color structure */
-typedef struct __attribute__((packed)) {
-	uint8_t r;
-	uint8_t g;
-	uint8_t b;
-} RGB;
-
-/** LED strip colors */
-static RGB history[LED_COUNT];
-
-/** Add a value to the averaging buffer. Returns currrent mean value */
-static float mbuf_add(MBuf *buf, float value)
-{
-	float aggr = value;
-	for (int i = MBUF_LEN - 1; i > 0; i--) {
-		float m = buf->data[i - 1];
-		aggr += m;
-		buf->data[i] = m;
-	}
-
-	buf->data[0] = value;
-
-	return aggr / (float)MBUF_LEN;
-}
-
-
-/** Wait long enough for the colors to show */
-static inline  __attribute__((always_inline))
-void ws_show(void)
-{
-	_delay_us(10);
-}
-
-/** Send one byte to the RGB strip */
-static inline  __attribute__((always_inline))
-void ws_send_byte(uint8_t bb)
-{
-	// If your LEDs don't work right, you may need to adjust the number of NOPs here
-	// It's a good idea to debug this with oscilloscope or a logic analyzer
-
-	for (int8_t i = 8; i > 0; i--) {
-		pin_up(WS_PIN);
-		if (bb & 0x80) {
-			__asm__ volatile("nop");
-			__asm__ volatile("nop");
-			__asm__ volatile("nop");
-			__asm__ volatile("nop");
-			__asm__ volatile("nop");
-			pin_down(WS_PIN);
-			__asm__ volatile("nop");
-		} else {
-			__asm__ volatile("nop");
-			pin_down(WS_PIN);
-			__asm__ volatile("nop");
-			__asm__ volatile("nop");
-			__asm__ volatile("nop");
-			__asm__ volatile("nop");
-			__asm__ volatile("nop");
-		}
-
-		bb = (uint8_t)(bb << 1);
-	}
-}
-
-/** Send a RGB color to the strip */
-static void ws_send_rgb(uint8_t r, uint8_t g, uint8_t b)
-{
-	ws_send_byte(g);
-	ws_send_byte(r);
-	ws_send_byte(b);
-}
 
 /** Init hardware resources */
 static void hw_init(void)
 {
-	usart_init(BAUD_115200);
+	usart_init(TELEM_DECIMATE ? TELEM_BAUD : BAUD_115200);
 
-	as_output(WS_PIN);
+	ws_init();
 
-	as_input_pu(ECHO1_PIN);
-	as_input_pu(ECHO2_PIN);
-	as_input_pu(ECHO3_PIN);
+	if (HAS_LED) {
+		as_output(LED_PIN);
+	}
+
+	sonar_add_all();
 
-	as_output(TRIG1_PIN);
-	as_output(TRIG2_PIN);
-	as_output(TRIG3_PIN);
+	PROF_INIT();
+	echo_init();
+	sonar_init();
+	render_init();
+	systick_init();
 
-	as_output(13);
+	sei();
 }
 
 /**
- * Measure one ultrasonic sensor distance
+ * Check if the LEDs can be refreshed now
  *
- * We could run all 3 at once, but then the sound waves tend to reflect
- * into different receives and you get false readings.
+ * The CPU-timed backends send a frame with interrupts off - not while
+ * an echo is being timed, its edges would get late timestamps.
  */
-static uint8_t meas(MBuf *mbuf, uint8_t trig_pin, uint8_t echo_pin)
+static bool led_can_refresh(void)
 {
-	// You may not need this 6ms delay, it's an attempt to avoid some strange
-	// behavior with cross-sensor reflections. 
-	_delay_ms(6);
-	// Even though they fire at different times, you still can get false readings
-	// (In my case, red + green sometimes cause blue to also turn on).
-	// This delay partially solved it for me, but YMMV.
-	
-	// --- Send the Trigger pulse ---
-	// The datasheet says you need 10 ms, but turns out 1 ms works just fine.
-	// Adjust as needed if this doesn't work for your sesors.
-	pin_up_n(trig_pin);
-	_delay_ms(1);
-	pin_down_n(trig_pin);
-	
-	// --- Wait for & measure the Echo pulse length ---
-	// We'll use a timer for this
-
-	MeasPhase meas_phase = MEAS_WAIT_1;
-
-	uint32_t echo = 0;
-
-	TCNT1 = 0;
-	TCCR1B = (0b010 << CS10);
-
-	while (true) {
-		if (meas_phase == MEAS_WAIT_1) {
-			if (pin_is_high_n(echo_pin)) {
-				// rising edge
-				echo = TCNT1;
-				meas_phase = MEAS_WAIT_0;
-			}
-		} else if (meas_phase == MEAS_WAIT_0) {
-			if (pin_is_low_n(echo_pin)) {
-				// falling edge, we're done
-				echo = TCNT1 - echo;
-				break;
-			}
-		}
-
-		// timeout - sometimes the sensor doesn't respond,
-		// and you'd get an infinite loop here.
-		if (TCNT1 >= 15000) {
-			echo = 15000;
-			break;
-		}
-	}
-
-	TCCR1B = 0; // stop the timer
-
-	// Pulse measured with 0.5us accuracy
-	// To convert to mm -> multiply by 0.8
+	return WS_BACKEND == WS_BACKEND_SPI || !sonar_listening();
+}
 
-	// --- convert to R/G/B value 0-255 ---
 
-	// The number '25.0f' here determines the sensitivity
-	float offset = 255 - echo / (1.25f * 25.0f);
+/** Update the colors from a finished sonar frame */
+static void sonar_measure(const SonarFrame *frame)
+{
+	uint8_t values[PIPE_CHANNELS];
+	RGB color;
 
-	if (offset > 255) {
-		offset = 255;
-	} else if (offset < 0) {
-		offset = 0;
+	PROF_START(t_math);
+	for (uint8_t i = 0; i < PIPE_CHANNELS; i++) {
+		values[i] = pipe_process(i, frame->echo[i]);
 	}
+	pipe_mix(values, &color);
+	PROF_STOP(PROF_MATH, t_math);
 
-	// averaging
-	offset = mbuf_add(mbuf, offset);
+	telem_frame(frame, values);
 
-	// to int
-	return (uint8_t) roundf(offset);
-}
+	render_push(color.r, color.g, color.b);
 
-/** Measure all 3 sensors and update the colors */
-static void sonar_measure(void)
-{
-	uint8_t c1 = meas(&mb_offs1, TRIG1_PIN, ECHO1_PIN);
-	uint8_t c2 = meas(&mb_offs2, TRIG2_PIN, ECHO2_PIN);
-	uint8_t c3 = meas(&mb_offs3, TRIG3_PIN, ECHO3_PIN);
-
-	for (int i = LED_COUNT - 1; i > 0; i--) {
-		history[i].r = history[i - 1].r;
-		history[i].g = history[i - 1].g;
-		history[i].b = history[i - 1].b;
-	}
+	PROF_FRAME_DONE();
+}
 
-	history[0].r = c1;
-	history[0].g = c2;
-	history[0].b = c3;
 
-	for (int i = 0; i < LED_COUNT; i++) {
-		ws_send_rgb(history[i].r, history[i].g, history[i].b);
-	}
+/** How often the time awake is printed, ms */
+#define AWAKE_REPORT_MS 1000
 
-	ws_show();
+/** Print the time awake per frame since the last report, over the frames handled since */
+static void report_awake(uint16_t *since_ms, uint16_t frames)
+{
+	uint16_t now = systick_ms();
+	uint32_t total_us = (uint32_t)(uint16_t)(now - *since_ms) * 1000;
+	uint32_t slept_us = idle_take_slept_us();
+	uint32_t awake_us = (slept_us < total_us) ? total_us - slept_us : 0;
+
+	*since_ms = now;
+
+	char buf[48];
+	snprintf_P(buf, sizeof(buf), PSTR("Awake: %lu us/frame (%u.%u %%)\r\n"),
+	           awake_us / frames,
+	           (unsigned)(awake_us * 100 / total_us),
+	           (unsigned)(awake_us * 1000 / total_us % 10));
+	usart_try_puts(buf);
 }
 
 
@@ -257,18 +124,54 @@ int main(void)
 	usart_puts_P(PSTR("\r\n"));
 	usart_puts_P(PSTR("===========================\r\n"));
 
+	// what the range gates and the scheduling bought us
+	char buf[64];
+	snprintf_P(buf, sizeof(buf), PSTR("Frame: %u ms worst case (%u ms saved)\r\n"),
+	           (unsigned) SONAR_WORST_FRAME_MS, (unsigned) SONAR_SAVED_MS);
+	usart_puts(buf);
+
 	int cnt = 0;
+	SonarFrame frame;
+	uint16_t report_ms = systick_ms();
+	uint16_t report_frames = 0; // frames handled since the last awake report
 
 	while (1) {
-		// This takes something close to 50 ms, varies with measured distances.
-		sonar_measure(); 
+		// The sonars are fired in the background, a frame comes every SONAR_FRAME_MS
+		if (sonar_take(&frame)) {
+			sonar_measure(&frame);
+
+			// (with telemetry on, this is in the packets)
+			if (frame.missed && TELEM_DECIMATE == 0) {
+				usart_try_puts_P(PSTR("Frame missed deadline\r\n"));
+			}
 
-		// Notice how the indicator blinking changes speed with distances
-		// You might want to do some adjustments here if you want 100% constant animation speed.
+			if (++cnt == SONAR_FPS) {
+				cnt = 0;
+				if (HAS_LED) {
+					pin_toggle(LED_PIN); // blink the indicator to show that we're OK
+				}
+			}
+
+			// by time - missed or dropped frames make fewer than SONAR_FPS a second
+			report_frames++;
+			if (IDLE_REPORT && (uint16_t)(systick_ms() - report_ms) >= AWAKE_REPORT_MS) {
+				report_awake(&report_ms, report_frames);
+				report_frames = 0;
+			}
+		}
+
+		// The LEDs are refreshed at their own rate, between the echoes
+		bool can_refresh = led_can_refresh();
+		PROF_START(t_led);
+		if (can_refresh && render_update()) {
+			PROF_STOP(PROF_LED, t_led);
+		}
 
-		if (++cnt == 20) {
-			cnt = 0;
-			pin_toggle(13); // blink the indicator to show that we're OK
+		// Nothing to do until the next interrupt
+		cli();
+		if (!sonar_ready() && !(render_ready() && led_can_refresh())) {
+			idle_sleep();
 		}
+		sei();
 	}
 }
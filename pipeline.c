@@ -0,0 +1,121 @@
+#include <avr/pgmspace.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lib/mbuf.h"
+#include "lib/median.h"
+#include "lib/track.h"
+#include "pipeline.h"
+
+/** Value drop per echo tick in 8.8 fixed point (256 / (1.25 * sensitivity)), integer part */
+#define ECHO_SCALE_INT(sens) (1024UL / (5 * (sens)))
+
+/** ..., fractional part (0.16) */
+#define ECHO_SCALE_FRAC(sens) ((1024UL * 65536UL + (5 * (sens)) / 2) / (5 * (sens)) - ECHO_SCALE_INT(sens) * 65536UL)
+
+/** Per-channel constants */
+typedef struct {
+	uint8_t scale_int;
+	uint16_t scale_frac;
+	uint8_t weight[3]; // r, g, b
+} PipeChannel;
+
+#define _PIPE_CHANNEL(trig, echo, sens, avg, r, g, b, min, max, dir) \
+	{ ECHO_SCALE_INT(sens), ECHO_SCALE_FRAC(sens), { (r), (g), (b) } },
+
+static const PipeChannel channels[PIPE_CHANNELS] PROGMEM = {
+	SENSORS(_PIPE_CHANNEL)
+};
+
+#if PIPE_SMOOTH == PIPE_SMOOTH_MEAN
+/** Averaging buffers (values are 8.8 fixed point), named after the trigger pin */
+#define _PIPE_MBUF(trig, echo, sens, avg, r, g, b, min, max, dir) MBUF_DEFINE(mb_offs##trig, avg);
+SENSORS(_PIPE_MBUF)
+
+#define _PIPE_MBUF_PTR(trig, echo, sens, avg, r, g, b, min, max, dir) &mb_offs##trig,
+static MBuf * const mbufs[PIPE_CHANNELS] = {
+	SENSORS(_PIPE_MBUF_PTR)
+};
+#else
+/** Trackers, values are 8.8 fixed point */
+static Track tracks[PIPE_CHANNELS];
+#endif
+
+#if PIPE_FILTER != PIPE_FILTER_NONE
+/** Spike filter windows, same naming */
+#define _PIPE_MEDBUF(trig, echo, sens, avg, r, g, b, min, max, dir) MEDBUF_DEFINE(md_offs##trig, PIPE_FILTER_LEN);
+SENSORS(_PIPE_MEDBUF)
+
+#define _PIPE_MEDBUF_PTR(trig, echo, sens, avg, r, g, b, min, max, dir) &md_offs##trig,
+static MedBuf * const medbufs[PIPE_CHANNELS] = {
+	SENSORS(_PIPE_MEDBUF_PTR)
+};
+#endif
+
+
+/** Convert an echo width to a channel value, 8.8 fixed point */
+uint16_t pipe_convert(uint8_t ch, uint16_t echo)
+{
+	// Pulse measured with 0.5us accuracy
+	// To convert to mm -> multiply by 0.8
+
+	uint8_t scale_int = pgm_read_byte(&channels[ch].scale_int);
+	uint16_t scale_frac = pgm_read_word(&channels[ch].scale_frac);
+
+	// 8.8 fixed point, same as 255 - echo / (1.25 * sensitivity)
+	uint32_t drop = (uint32_t) echo * scale_int
+	              + (((uint32_t) echo * scale_frac + 0x8000) >> 16);
+
+	if (drop >= (255U << 8)) {
+		return 0;
+	}
+
+	return (uint16_t)((255U << 8) - drop);
+}
+
+
+/** Process a measured echo width */
+uint8_t pipe_process(uint8_t ch, uint16_t echo)
+{
+	uint16_t offset = pipe_convert(ch, echo);
+
+	// spike filter
+#if PIPE_FILTER == PIPE_FILTER_MEDIAN
+	offset = medbuf_add(medbufs[ch], offset);
+#elif PIPE_FILTER == PIPE_FILTER_HAMPEL
+	offset = medbuf_hampel(medbufs[ch], offset, MEDBUF_HAMPEL_K(PIPE_HAMPEL_K), PIPE_HAMPEL_MIN);
+#endif
+
+	// smoothing
+#if PIPE_SMOOTH == PIPE_SMOOTH_MEAN
+	offset = mbuf_add(mbufs[ch], offset);
+#else
+	track_update(&tracks[ch], offset, TRACK_COEF(PIPE_TRACK_ALPHA), TRACK_COEF(PIPE_TRACK_BETA));
+	offset = track_predict(&tracks[ch], PIPE_TRACK_LEAD);
+	if (offset > (255U << 8)) {
+		offset = 255U << 8; // overshoot
+	}
+#endif
+
+	// to int, rounded
+	return (uint8_t)((offset + 0x80) >> 8);
+}
+
+
+/** Mix channel values into a color */
+void pipe_mix(const uint8_t *values, RGB *color)
+{
+	uint16_t sum[3] = {0, 0, 0};
+
+	for (uint8_t ch = 0; ch < PIPE_CHANNELS; ch++) {
+		for (uint8_t c = 0; c < 3; c++) {
+			uint8_t w = pgm_read_byte(&channels[ch].weight[c]);
+			// value * w / 255, exact for w = 255
+			sum[c] += ((uint16_t) values[ch] * w + 255) >> 8;
+		}
+	}
+
+	color->r = (uint8_t)(sum[0] > 255 ? 255 : sum[0]);
+	color->g = (uint8_t)(sum[1] > 255 ? 255 : sum[1]);
+	color->b = (uint8_t)(sum[2] > 255 ? 255 : sum[2]);
+}
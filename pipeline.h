@@ -0,0 +1,114 @@
+#pragma once
+
+//
+//  Signal pipeline - converts measured echo widths to channel values
+//  (0-255, closer = brighter), smooths them and mixes them into a color.
+//
+//  The channels, their sensitivity, averaging and color contribution
+//  come from the sensor table in sensors.h.
+//
+//  There's no hardware access here, this also builds on the host
+//  (see host/).
+//
+
+#include <stdint.h>
+
+#include "sensors.h"
+#include "strip.h"
+
+/** Number of channels (one per sensor) */
+#define PIPE_CHANNELS SENSOR_COUNT
+
+// Spike filter, applied to each converted sample before the averaging:
+//
+//  - PIPE_FILTER_NONE: just the mean
+//  - PIPE_FILTER_MEDIAN: running median of PIPE_FILTER_LEN samples
+//  - PIPE_FILTER_HAMPEL: samples further than PIPE_HAMPEL_K deviations
+//    (but at least PIPE_HAMPEL_MIN) from the median are replaced by it
+//
+// To use the filter instead of the mean, set avg_len to 1 in sensors.h.
+// See lib/median.h.
+
+#define PIPE_FILTER_NONE   0
+#define PIPE_FILTER_MEDIAN 1
+#define PIPE_FILTER_HAMPEL 2
+
+#ifndef PIPE_FILTER
+#define PIPE_FILTER PIPE_FILTER_NONE
+#endif
+
+/**
+ * Filter window length (odd; 5..9 is sensible)
+ *
+ * `make bench-host` (3000000 samples): of 69373 spikes, the median leaves
+ * 136 with 5, 11 with 7 and 8 with 9 - all under the limit there (5 per
+ * mille, 346). 5 is the default as the shortest of them; a longer window
+ * also delays a change by (len - 1) / 2 more frames. Its cost on the AVR
+ * isn't measured yet (see the README).
+ */
+#ifndef PIPE_FILTER_LEN
+#define PIPE_FILTER_LEN 5
+#endif
+
+/** Hampel filter threshold, in standard deviations */
+#ifndef PIPE_HAMPEL_K
+#define PIPE_HAMPEL_K 3
+#endif
+
+/** Hampel filter lowest threshold, 8.8 fixed point (in channel values) */
+#ifndef PIPE_HAMPEL_MIN
+#define PIPE_HAMPEL_MIN (8 << 8)
+#endif
+
+// Smoothing, after the spike filter:
+//
+//  - PIPE_SMOOTH_MEAN: moving average of avg_len samples (sensors.h).
+//    Simple, but a step shows up with a delay of about avg_len / 2 frames.
+//  - PIPE_SMOOTH_TRACK: alpha-beta tracker (lib/track.h) that follows
+//    the distance and its speed, and extrapolates PIPE_TRACK_LEAD frames
+//    ahead to the time the sample gets shown. avg_len is not used.
+
+#define PIPE_SMOOTH_MEAN  0
+#define PIPE_SMOOTH_TRACK 1
+
+#ifndef PIPE_SMOOTH
+#define PIPE_SMOOTH PIPE_SMOOTH_MEAN
+#endif
+
+/**
+ * Tracker gains (0..1); lower is smoother, but slower
+ *
+ * Tuned with the noise replay of host/bench: at 0.25, a still target
+ * jitters a little less than with a 4-sample average, and a step is
+ * followed 90 % after 4 frames (14 with a 16-sample average). A step
+ * still overshoots by about a fifth for a few frames; at 0.4, that was
+ * more and the jitter higher than the input's half.
+ */
+#ifndef PIPE_TRACK_ALPHA
+#define PIPE_TRACK_ALPHA 0.25
+#endif
+
+/** ..., critically damped by default */
+#ifndef PIPE_TRACK_BETA
+#define PIPE_TRACK_BETA (PIPE_TRACK_ALPHA * PIPE_TRACK_ALPHA / (2 - PIPE_TRACK_ALPHA))
+#endif
+
+/**
+ * Tracker extrapolation, frames in 8.8 fixed point
+ *
+ * The strip scrolls a new sample in over one frame (see render.h),
+ * so on average it is shown half a frame after it was measured. Leading
+ * by more also extrapolates the noise, and makes the overshoot bigger.
+ */
+#ifndef PIPE_TRACK_LEAD
+#define PIPE_TRACK_LEAD 128
+#endif
+
+/** Convert an echo width (Timer1 ticks) to a channel value, 8.8 fixed point */
+uint16_t pipe_convert(uint8_t ch, uint16_t echo);
+
+/** Process a measured echo width. Returns the new channel value. */
+uint8_t pipe_process(uint8_t ch, uint16_t echo);
+
+/** Mix channel values (PIPE_CHANNELS of them) into a color */
+void pipe_mix(const uint8_t *values, RGB *color);
@@ -0,0 +1,167 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <util/atomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <stdio.h>
+
+#include "lib/calc.h"
+#include "lib/usart.h"
+#include "prof.h"
+
+#if PROF_ENABLE
+
+/** Timer0 ticks per microsecond */
+#define PROF_TICKS_PER_US (F_CPU / 8000000UL)
+
+/* Stats of one stage */
+typedef struct {
+	uint16_t count;
+	uint32_t sum;
+	uint32_t min;
+	uint32_t max;
+} ProfStat;
+
+static ProfStat stats[PROF_STAGES];
+
+/** Stats of the last PROF_DUMP_FRAMES frames, being printed */
+static ProfStat snapshot[PROF_STAGES];
+static uint8_t print_pos = PROF_STAGES;
+
+static const char stage_names[PROF_STAGES][7] PROGMEM = {
+	"wait", "trig", "listen", "math", "led"
+};
+
+/** Timer0 overflows (upper 24 bits of the time) */
+static volatile uint32_t prof_ovf = 0;
+
+/** Time of the last lap */
+static uint32_t lap_start = 0;
+
+static uint8_t frames = 0;
+
+
+/** Start Timer0 */
+void prof_init(void)
+{
+	TCCR0A = 0;
+	TCCR0B = (0b010 << CS00); // clk/8
+	TCNT0 = 0;
+	sbi(TIMSK0, TOIE0);
+
+	for (uint8_t i = 0; i < PROF_STAGES; i++) {
+		stats[i].min = UINT32_MAX;
+	}
+}
+
+
+/** Current time in Timer0 ticks */
+uint32_t prof_now(void)
+{
+	uint32_t ovf;
+	uint8_t t;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		ovf = prof_ovf;
+		t = TCNT0;
+
+		// overflowed, but the ISR didn't run yet
+		if (bit_is_high(TIFR0, TOV0) && t < 128) {
+			ovf++;
+		}
+	}
+
+	return (ovf << 8) | t;
+}
+
+
+/** Add a stage duration to the stats */
+void prof_record(ProfStage stage, uint32_t ticks)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		ProfStat *st = &stats[stage];
+
+		st->count++;
+		st->sum += ticks;
+		if (ticks < st->min) st->min = ticks;
+		if (ticks > st->max) st->max = ticks;
+	}
+}
+
+
+/** Record the time since the last lap, start a new lap */
+void prof_lap(ProfStage stage)
+{
+	uint32_t now = prof_now();
+	prof_record(stage, now - lap_start);
+	lap_start = now;
+}
+
+
+/** Start a new lap without recording */
+void prof_lap_reset(void)
+{
+	lap_start = prof_now();
+}
+
+
+/** Take a snapshot of the stats and clear them */
+static void prof_snapshot(void)
+{
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		for (uint8_t i = 0; i < PROF_STAGES; i++) {
+			snapshot[i] = stats[i];
+			stats[i].count = 0;
+			stats[i].sum = 0;
+			stats[i].min = UINT32_MAX;
+			stats[i].max = 0;
+		}
+	}
+}
+
+
+/** Print one stage of the snapshot */
+static void prof_print(uint8_t i)
+{
+	// longest line: "prof listen: 4294967295/4294967295/4294967295 us (n=65535)\r\n", 60 chars
+	char buf[64];
+	ProfStat *st = &snapshot[i];
+
+	if (st->count == 0) {
+		return;
+	}
+
+	snprintf_P(buf, sizeof(buf), PSTR("prof %S: %lu/%lu/%lu us (n=%u)\r\n"),
+	           stage_names[i],
+	           st->min / PROF_TICKS_PER_US,
+	           st->sum / st->count / PROF_TICKS_PER_US,
+	           st->max / PROF_TICKS_PER_US,
+	           st->count);
+
+	usart_try_puts(buf);
+}
+
+
+/** Count a finished frame */
+void prof_frame_done(void)
+{
+	// One stage per frame, so a line always fits in the TX buffer
+	if (print_pos < PROF_STAGES) {
+		prof_print(print_pos++);
+	}
+
+	if (++frames >= PROF_DUMP_FRAMES) {
+		frames = 0;
+		prof_snapshot();
+		print_pos = 0;
+	}
+}
+
+
+ISR(TIMER0_OVF_vect)
+{
+	prof_ovf++;
+}
+
+#endif
@@ -0,0 +1,86 @@
+#pragma once
+
+//
+//  Hot-path profiler - time spent in each stage of a frame.
+//
+//  Compiled out unless PROF_ENABLE is 1 (see Makefile). When enabled,
+//  Timer0 runs freely at F_CPU/8 (0.5 us at 16 MHz) as the clock,
+//  min / mean / max of each stage are collected every PROF_DUMP_FRAMES
+//  frames and printed over the USART, one stage per frame:
+//
+//    prof trig: 996/1001/1004 us (n=60)
+//
+//  (The lines are plain text - with telemetry on, the decoder skips them.)
+//
+//  Stages are timed either with a start/stop pair:
+//
+//    PROF_START(t);
+//    ...
+//    PROF_STOP(PROF_MATH, t);
+//
+//  or, for back-to-back stages, with laps - each lap records the time
+//  since the previous lap (with sensors running at the same time, that's
+//  the time between scheduler events of any sensor):
+//
+//    PROF_LAP_RESET();
+//    ...
+//    PROF_LAP(PROF_WAIT);
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#ifndef PROF_ENABLE
+#define PROF_ENABLE 0
+#endif
+
+/** Print the stats every N frames */
+#define PROF_DUMP_FRAMES 20
+
+/** Profiled stages */
+typedef enum {
+	PROF_WAIT,    // until a sensor is fired
+	PROF_TRIG,    // trigger pulse
+	PROF_LISTEN,  // waiting for the echo
+	PROF_MATH,    // echo to channel value
+	PROF_LED,     // LED strip output
+	PROF_STAGES
+} ProfStage;
+
+#if PROF_ENABLE
+
+/** Start Timer0 */
+void prof_init(void);
+
+/** Current time in Timer0 ticks */
+uint32_t prof_now(void);
+
+/** Add a stage duration to the stats */
+void prof_record(ProfStage stage, uint32_t ticks);
+
+/** Record the time since the last lap, start a new lap */
+void prof_lap(ProfStage stage);
+
+/** Start a new lap without recording */
+void prof_lap_reset(void);
+
+/** Count a finished frame, print the stats every PROF_DUMP_FRAMES */
+void prof_frame_done(void);
+
+#define PROF_INIT()              prof_init()
+#define PROF_START(var)          uint32_t var = prof_now()
+#define PROF_STOP(stage, var)    prof_record((stage), prof_now() - (var))
+#define PROF_LAP(stage)          prof_lap(stage)
+#define PROF_LAP_RESET()         prof_lap_reset()
+#define PROF_FRAME_DONE()        prof_frame_done()
+
+#else
+
+#define PROF_INIT()              do {} while (0)
+#define PROF_START(var)          do {} while (0)
+#define PROF_STOP(stage, var)    do {} while (0)
+#define PROF_LAP(stage)          do {} while (0)
+#define PROF_LAP_RESET()         do {} while (0)
+#define PROF_FRAME_DONE()        do {} while (0)
+
+#endif
@@ -0,0 +1,113 @@
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lib/systick.h"
+#include "strip.h"
+#include "render.h"
+
+#if RENDER_HZ > 0
+
+/** Refresh period, ms */
+#define RENDER_MS (1000 / RENDER_HZ)
+
+_Static_assert(RENDER_MS >= 1 && RENDER_MS <= 255, "RENDER_HZ must be 4..1000");
+
+static volatile bool render_due = false;
+static uint8_t render_ticks = 0;
+
+/** Systick time of the last sample */
+static uint16_t last_push_ms;
+
+/** Time between the last two samples, ms */
+static uint16_t sample_ms = 1;
+
+
+/** Count the ms to the next refresh, called every ms */
+static void render_tick(void)
+{
+	if (++render_ticks >= RENDER_MS) {
+		render_ticks = 0;
+		render_due = true;
+	}
+}
+
+
+/** Register the refresh tick */
+void render_init(void)
+{
+	systick_add(render_tick);
+}
+
+
+/** Add a new color sample to the strip */
+void render_push(uint8_t r, uint8_t g, uint8_t b)
+{
+	uint16_t now = systick_ms();
+
+	sample_ms = now - last_push_ms;
+	if (sample_ms == 0) {
+		sample_ms = 1;
+	}
+	last_push_ms = now;
+
+	strip_push(r, g, b);
+}
+
+
+/** Check if it's time to refresh the strip */
+bool render_ready(void)
+{
+	return render_due;
+}
+
+
+/** Refresh the strip if it's time */
+bool render_update(void)
+{
+	if (!render_due) {
+		return false;
+	}
+	render_due = false;
+
+	// how far we are towards the next sample, if it comes after the same time
+	uint16_t elapsed = systick_ms() - last_push_ms;
+	uint16_t phase = STRIP_PHASE_END;
+
+	if (elapsed < sample_ms) {
+		phase = (uint16_t)(((uint32_t) elapsed * STRIP_PHASE_END) / sample_ms);
+	}
+
+	strip_render(phase);
+	return true;
+}
+
+#else
+
+/** Register the refresh tick */
+void render_init(void)
+{
+}
+
+
+/** Add a new color sample to the strip, and show it */
+void render_push(uint8_t r, uint8_t g, uint8_t b)
+{
+	strip_push(r, g, b);
+	strip_show();
+}
+
+
+/** Check if it's time to refresh the strip */
+bool render_ready(void)
+{
+	return false;
+}
+
+
+/** Refresh the strip if it's time */
+bool render_update(void)
+{
+	return false;
+}
+
+#endif
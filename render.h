@@ -0,0 +1,38 @@
+#pragma once
+
+//
+//  Fixed-rate LED refresh, independent of the sonar frames.
+//
+//  The strip is refreshed RENDER_HZ times per second from the main loop,
+//  timed by the systick. Between two sonar samples, the strip scrolls
+//  smoothly towards the newest one, at the pace the samples came in
+//  recently - when ranging slows down (eg. a sensor times out), the
+//  scrolling slows down too instead of jumping.
+//
+//    render_init();            // before systick_init()
+//    ...
+//    render_push(r, g, b);     // a new sample
+//    render_update();          // in the main loop
+//
+//  With RENDER_HZ = 0, the strip is refreshed once per sample instead.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+/** Refresh rate, Hz (0 = refresh with every sample) */
+#ifndef RENDER_HZ
+#define RENDER_HZ 100
+#endif
+
+/** Register the refresh tick */
+void render_init(void);
+
+/** Add a new color sample to the strip */
+void render_push(uint8_t r, uint8_t g, uint8_t b);
+
+/** Check if it's time to refresh the strip */
+bool render_ready(void);
+
+/** Refresh the strip if it's time. Returns true if it was refreshed. */
+bool render_update(void);
@@ -0,0 +1,51 @@
+#pragma once
+
+//
+//  Sensor configuration - one line per sonar.
+//
+//    X(trig_pin, echo_pin, sensitivity, avg_len, red, green, blue, min_cm, max_cm, dir)
+//
+//  - trig_pin, echo_pin: Arduino pin numbers, as plain numbers (they are
+//    pasted into the iopins macros); trigger pins must be unique.
+//    An echo on D8 uses the Timer1 input capture, others use pin-change
+//    interrupts (see lib/echo.h)
+//  - sensitivity: the value drops by 1 every 1.25 * sensitivity echo ticks
+//  - avg_len: averaging buffer length (number of samples, 1..255;
+//    powers of two are faster; not used with PIPE_SMOOTH_TRACK, see pipeline.h)
+//  - red, green, blue: how much the sensor contributes to each color,
+//    0..255 (255 = the sensor's value as it is). Contributions of all
+//    sensors are added up and clipped at 255.
+//  - min_cm, max_cm: range gate. Echoes from closer than min_cm (ringing
+//    of the sensor itself) count as no echo, and the listening stops as
+//    soon as an echo would be from further than max_cm (up to 125 cm).
+//    Past 2.75 * sensitivity cm the value is 0 anyway - 70 cm for 25.
+//  - dir: direction the sensor faces, degrees. Sensors facing about the
+//    same way (less than SONAR_CROSS_DEG apart) are fired one after
+//    another, in this order; the others at the same time (see sonar.h).
+//
+//  The sonar and pipeline state is sized from this table, about 35 bytes
+//  of RAM per sensor plus 2 * avg_len for the averaging; a frame takes
+//  at most SONAR_SENSOR_MS(max_cm) per sensor (see sonar.h), and each
+//  sensor takes an echo capture slot (9 bytes, ECHO_CHANNELS in the
+//  Makefile - see lib/echo.h).
+//
+
+#include "ws2812.h"
+
+#if WS_BACKEND == WS_BACKEND_SPI
+// D10..D13 are used by the SPI
+#define SENSORS(X) \
+	X( 3,  2, 25, 16, 255,   0,   0, 2, 70, 0) \
+	X( 9,  8, 25, 16,   0, 255,   0, 2, 70, 0) \
+	X( 5,  6, 25, 16,   0,   0, 255, 2, 70, 0)
+#else
+#define SENSORS(X) \
+	X( 3,  2, 25, 16, 255,   0,   0, 2, 70, 0) \
+	X( 9,  8, 25, 16,   0, 255,   0, 2, 70, 0) \
+	X(11, 10, 25, 16,   0,   0, 255, 2, 70, 0)
+#endif
+
+#define _SENSOR_ONE(trig, echo, sens, avg, r, g, b, min, max, dir) + 1
+
+/** Number of sensors in the table */
+#define SENSOR_COUNT (0 SENSORS(_SENSOR_ONE))
@@ -0,0 +1,446 @@
+#include <avr/io.h>
+#include <util/atomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lib/calc.h"
+#include "lib/iopins.h"
+#include "lib/echo.h"
+#include "lib/systick.h"
+#include "sonar.h"
+#include "prof.h"
+
+_Static_assert(SONAR_COUNT <= ECHO_CHANNELS, "Too many sensors, raise ECHO_CHANNELS in the Makefile");
+_Static_assert(SONAR_COUNT <= 8, "Too many sensors, the masks are 8-bit");
+_Static_assert(SONAR_WORST_FRAME_MS <= SONAR_FRAME_MS, "SONAR_FPS is too high for this many sensors");
+
+#define _SONAR_GATE_CHECK(trig, echo, sens, avg, r, g, b, min, max, dir) \
+	_Static_assert((min) < (max) && SONAR_CM_TICKS(max) < SONAR_TIMEOUT, "Bad range gate in sensors.h");
+SENSORS(_SONAR_GATE_CHECK)
+
+/** Phase of a sensor within the frame (state-machine state) */
+typedef enum {
+	SONAR_WAIT,   // waiting for the sensors it could hear to finish
+	SONAR_TRIG,   // trigger pulse
+	SONAR_LISTEN, // waiting for the echo
+	SONAR_TAIL,   // out of range, but its ping hasn't come back - quiet gap
+	SONAR_DONE    // measured
+} SonarPhase;
+
+/* Sensor entry */
+typedef struct {
+	PinHandle trig;
+	uint8_t echo_ch;
+	uint16_t min; // shortest echo, Timer1 ticks
+	uint16_t max; // longest echo, Timer1 ticks
+	int16_t dir;  // direction it faces, degrees
+	uint8_t hears; // mask of sensors that can hear its pings (and itself)
+
+	SonarPhase phase;
+	uint8_t phase_ms; // remaining ms of the trigger pulse / quiet gap
+	uint8_t order;    // firing order within the frame
+	uint16_t listen_start; // trigger, then listen window start (Timer1 time)
+	uint16_t rx;      // time the echo came back (Timer1 time)
+	uint8_t rx_ms;    // ..., ms into the frame
+	uint16_t width;   // its width (Timer1 ticks)
+	uint8_t rx_fired; // sensors fired by then
+	bool has_rx;      // rx is valid
+} Sonar;
+
+static Sonar sonars[SONAR_COUNT];
+static uint8_t sonar_next_slot = 0;
+
+/** A frame is being measured */
+static volatile bool running = false;
+
+/** Sensors waiting for their echo (bit mask) */
+static volatile uint8_t listening = 0;
+
+/** Sensors fired so far in this frame */
+static uint8_t fired;
+
+/** Ms until the next frame starts */
+static uint16_t frame_ms;
+
+/** The deadline passed while the frame was running */
+static bool late = false;
+
+/** Frame being measured */
+static SonarFrame work;
+
+/** Last finished frame */
+static SonarFrame done;
+static volatile bool done_valid = false;
+
+static volatile uint16_t missed_count = 0;
+static volatile uint16_t xtalk_count = 0;
+
+
+uint8_t sonar_add_do(uint8_t trig_pin, uint8_t echo_ch, uint16_t min, uint16_t max, int16_t dir)
+{
+	Sonar *s = &sonars[sonar_next_slot];
+
+	s->trig = pin_handle(trig_pin);
+	s->echo_ch = echo_ch;
+	s->min = min;
+	s->max = max;
+	s->dir = dir;
+
+	as_output_h(&s->trig);
+	pin_down_h(&s->trig);
+
+	return sonar_next_slot++;
+}
+
+
+/** Check if two sensors face close enough to hear each other */
+static bool sonar_can_hear(const Sonar *a, const Sonar *b)
+{
+	int16_t diff = (int16_t)((a->dir - b->dir) % 360);
+
+	if (diff < 0) {
+		diff = -diff;
+	}
+	if (diff > 180) {
+		diff = 360 - diff;
+	}
+
+	return diff < SONAR_CROSS_DEG;
+}
+
+
+/** Start a new frame */
+static void start_frame(void)
+{
+	for (uint8_t i = 0; i < sonar_next_slot; i++) {
+		sonars[i].phase = SONAR_WAIT;
+		sonars[i].has_rx = false;
+	}
+
+	fired = 0;
+	work.start_ms = systick_ms();
+	work.duration_ms = 0;
+	work.xtalk = 0;
+	running = true;
+}
+
+
+/** Note when the echo came back */
+static void sonar_rx(Sonar *s)
+{
+	s->width = echo_width(s->echo_ch);
+	s->rx = echo_rise(s->echo_ch) + s->width;
+
+	// rx wraps with Timer1, the frame can be longer
+	uint16_t age = (uint16_t)(echo_now() - s->rx) / (ECHO_TICKS_PER_US * 1000);
+	s->rx_ms = (uint8_t)(work.duration_ms - age);
+	s->rx_fired = fired;
+	s->has_rx = true;
+}
+
+
+/**
+ * Drop echoes that came back with another sensor's second echo
+ *
+ * A ping that came back can bounce off the sensor and the target again,
+ * and come back one echo width later. A sensor that hears it and was
+ * fired after the first echo came back, and gets its echo at that time,
+ * has most likely heard the other one's ping - the other sensor's
+ * expected window. Sensors fired before the other's echo came back
+ * can't be told apart like this, the quiet gap keeps them from firing.
+ */
+static void reject_xtalk(void)
+{
+	for (uint8_t i = 0; i < sonar_next_slot; i++) {
+		Sonar *x = &sonars[i];
+
+		if (x->phase != SONAR_DONE || work.echo[i] == SONAR_TIMEOUT) {
+			continue; // no echo to reject
+		}
+
+		for (uint8_t j = 0; j < sonar_next_slot; j++) {
+			const Sonar *y = &sonars[j];
+
+			if (j == i || !(x->hears & (1 << j)) || !y->has_rx || y->rx_fired > x->order) {
+				continue;
+			}
+
+			// the Timer1 times are close, and not a wrap apart
+			int16_t diff = (int16_t)(x->rx - (uint16_t)(y->rx + y->width));
+			int8_t diff_ms = (int8_t)(x->rx_ms - (uint8_t)(y->rx_ms + y->width / (ECHO_TICKS_PER_US * 1000)));
+
+			if (diff > -(int16_t) SONAR_XTALK_TICKS && diff < (int16_t) SONAR_XTALK_TICKS &&
+			    diff_ms >= -SONAR_XTALK_SLACK_MS && diff_ms <= SONAR_XTALK_SLACK_MS) {
+				work.echo[i] = SONAR_TIMEOUT;
+				work.xtalk |= (uint8_t)(1 << i);
+				xtalk_count++;
+				break;
+			}
+		}
+	}
+}
+
+
+/** Publish the current frame and go idle */
+static void finish_frame(void)
+{
+	reject_xtalk();
+
+	done = work;
+	done_valid = true;
+	work.missed = false;
+
+	running = false;
+}
+
+
+/** Check if there's no use waiting for the echo any longer */
+static bool listen_over(const Sonar *s)
+{
+	uint8_t ch = s->echo_ch;
+
+	if (echo_in_pulse(ch)) {
+		// the echo would be from too far
+		return (uint16_t)(echo_now() - echo_rise(ch)) >= s->max;
+	}
+
+	// sometimes the sensor doesn't respond
+	return (uint16_t)(echo_now() - s->listen_start) >= SONAR_RISE_TICKS;
+}
+
+
+/** Advance the sensors of a running frame. Returns true when all are measured. */
+static bool frame_tick(void)
+{
+	// sensors with a ping in the air
+	uint8_t busy = 0;
+	for (uint8_t i = 0; i < sonar_next_slot; i++) {
+		if (sonars[i].phase == SONAR_TRIG || sonars[i].phase == SONAR_LISTEN || sonars[i].phase == SONAR_TAIL) {
+			busy |= (uint8_t)(1 << i);
+		}
+	}
+
+	bool triggered = false;
+	bool pending = false;
+
+	for (uint8_t i = 0; i < sonar_next_slot; i++) {
+		Sonar *s = &sonars[i];
+		uint8_t ch = s->echo_ch;
+
+		switch (s->phase) {
+			case SONAR_WAIT:
+				// one trigger per tick, so overlapping sensors are apart in time
+				if (triggered || (busy & s->hears)) {
+					pending = true;
+					break;
+				}
+
+				PROF_LAP(PROF_WAIT);
+				pin_up_h(&s->trig);
+				s->listen_start = echo_now();
+				s->phase = SONAR_TRIG;
+				s->phase_ms = SONAR_TRIG_MS;
+				s->order = fired++;
+				busy |= (uint8_t)(1 << i);
+				triggered = true;
+				pending = true;
+				break;
+
+			case SONAR_TRIG:
+				if (s->phase_ms > 0) {
+					s->phase_ms--;
+				}
+
+				// a caught-up tick can come right after the one that raised it
+				if (s->phase_ms == 0 && (uint16_t)(echo_now() - s->listen_start) >= SONAR_TRIG_MIN_TICKS) {
+					PROF_LAP(PROF_TRIG);
+					echo_arm(ch);
+					s->listen_start = echo_now();
+					pin_down_h(&s->trig);
+					s->phase = SONAR_LISTEN;
+				}
+				pending = true;
+				break;
+
+			case SONAR_LISTEN:
+				if (echo_ready(ch)) {
+					sonar_rx(s);
+
+					// too close is the sensor's own ringing, too far is out of range
+					work.echo[i] = (s->width < s->min || s->width > s->max) ? SONAR_TIMEOUT : s->width;
+					s->phase = SONAR_DONE;
+				} else if (listen_over(s)) {
+					work.echo[i] = SONAR_TIMEOUT;
+
+					if (echo_in_pulse(ch)) {
+						// the ping is still out there, the others wait for it
+						s->phase = SONAR_TAIL;
+						s->phase_ms = SONAR_GAP_MS;
+					} else {
+						echo_cancel(ch);
+						s->phase = SONAR_DONE;
+					}
+				} else {
+					pending = true;
+					break; // keep listening
+				}
+
+				PROF_LAP(PROF_LISTEN);
+
+				if (s->phase == SONAR_TAIL) {
+					pending = true;
+					break;
+				}
+
+				// the sensors that waited for this one can go right away
+				busy &= (uint8_t) ~(1 << i);
+				break;
+
+			case SONAR_TAIL:
+				if (echo_ready(ch)) {
+					sonar_rx(s); // for the windowing of the later sensors
+				} else if (--s->phase_ms == 0) {
+					echo_cancel(ch); // died out
+				} else {
+					pending = true;
+					break;
+				}
+
+				s->phase = SONAR_DONE;
+				busy &= (uint8_t) ~(1 << i);
+				break;
+
+			case SONAR_DONE:
+				break;
+		}
+	}
+
+	uint8_t mask = 0;
+	for (uint8_t i = 0; i < sonar_next_slot; i++) {
+		if (sonars[i].phase == SONAR_LISTEN || sonars[i].phase == SONAR_TAIL) {
+			mask |= (uint8_t)(1 << i);
+		}
+	}
+	listening = mask;
+
+	return !pending;
+}
+
+
+/** Advance the scheduler, called every ms */
+static void sonar_tick(void)
+{
+	bool frame_due = false;
+
+	if (frame_ms > 0) {
+		frame_ms--;
+	}
+
+	if (frame_ms == 0) {
+		frame_due = true;
+		frame_ms = SONAR_FRAME_MS;
+	}
+
+	if (frame_due && running) {
+		// still working on the previous frame
+		if (!work.missed) {
+			missed_count++;
+			work.missed = true;
+		}
+		late = true;
+	}
+
+	if (running) {
+		work.duration_ms++;
+	} else if (frame_due || late) {
+		if (late) {
+			// start right away, the period restarts from now
+			late = false;
+			frame_ms = SONAR_FRAME_MS;
+		}
+		PROF_LAP_RESET();
+		start_frame();
+	}
+
+	if (running && frame_tick()) {
+		finish_frame();
+	}
+}
+
+
+/** Start the scheduler */
+void sonar_init(void)
+{
+	// who can hear whose pings
+	for (uint8_t i = 0; i < sonar_next_slot; i++) {
+		sonars[i].hears = 0;
+		for (uint8_t j = 0; j < sonar_next_slot; j++) {
+			if (sonar_can_hear(&sonars[i], &sonars[j])) {
+				sonars[i].hears |= (uint8_t)(1 << j);
+			}
+		}
+	}
+
+	frame_ms = 1;
+	systick_add(sonar_tick);
+}
+
+
+/** Check if there's a finished frame to take */
+bool sonar_ready(void)
+{
+	return done_valid;
+}
+
+
+/** Check if an echo is being timed */
+bool sonar_listening(void)
+{
+	return listening != 0;
+}
+
+
+/** Get a finished frame */
+bool sonar_take(SonarFrame *frame)
+{
+	bool valid;
+
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		valid = done_valid;
+		if (valid) {
+			*frame = done;
+			done_valid = false;
+		}
+	}
+
+	return valid;
+}
+
+
+/** Number of sensors added */
+uint8_t sonar_count(void)
+{
+	return sonar_next_slot;
+}
+
+
+/** Number of frames that missed the deadline */
+uint16_t sonar_missed_count(void)
+{
+	uint16_t n;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		n = missed_count;
+	}
+	return n;
+}
+
+
+/** Number of echoes rejected as cross-talk */
+uint16_t sonar_xtalk_count(void)
+{
+	uint16_t n;
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		n = xtalk_count;
+	}
+	return n;
+}
@@ -0,0 +1,183 @@
+#pragma once
+
+//
+//  Non-blocking sonar scheduler.
+//
+//  We could run all sensors at once, but then the sound waves tend to reflect
+//  into different receivers and you get false readings. So the sensors are
+//  fired from the systick interrupt, each as soon as no sensor that could
+//  hear its ping is listening:
+//
+//    trigger pulse -> listen window -> next sensor ...
+//
+//  Sensors facing at least SONAR_CROSS_DEG apart (dir in sensors.h) don't
+//  hear each other and run at the same time, one ms apart. The others
+//  take turns in the order of the table.
+//
+//  Pings still bounce around the room after the listen window is over, so
+//  a sensor can hear a ping of one fired before it. A sensor that times
+//  out while its echo pulse is still high (its ping is still out there)
+//  keeps the sensors that hear it waiting until the echo comes back, or
+//  SONAR_GAP_MS at most. An echo that came back can bounce off the sensor
+//  and come back again, one echo width later - a sensor fired after the
+//  first one came back that hears something within SONAR_XTALK_US of that
+//  drops it as cross-talk, see SonarFrame.xtalk.
+//
+//  A new frame starts every SONAR_FRAME_MS. When the previous frame
+//  is still running at that time, the frame has missed its deadline;
+//  the next one then starts as soon as it's finished.
+//
+//  Each sensor listens only as long as an echo from its max_cm could take,
+//  so a frame takes at most SONAR_SENSOR_MS(max_cm) per sensor.
+//
+//  The main loop collects finished frames with sonar_take().
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lib/echo.h"
+#include "sensors.h"
+
+/** Max number of sensors */
+#define SONAR_COUNT SENSOR_COUNT
+
+/** Sensors facing less than this many degrees apart hear each other */
+#ifndef SONAR_CROSS_DEG
+#define SONAR_CROSS_DEG 60
+#endif
+
+/**
+ * Echoes this close to an earlier sensor's second echo are cross-talk, us
+ *
+ * Covers the different paths to the sensors - about 1 cm per 58 us.
+ */
+#ifndef SONAR_XTALK_US
+#define SONAR_XTALK_US 300
+#endif
+
+#define SONAR_XTALK_TICKS ((uint16_t)(SONAR_XTALK_US * ECHO_TICKS_PER_US))
+
+/**
+ * ..., and this close in ms into the frame
+ *
+ * Timer1 wraps every 32 ms, a frame can take longer - the coarse times
+ * (off by a ms or two) tell the wraps apart.
+ */
+#define SONAR_XTALK_SLACK_MS 3
+
+/**
+ * Trigger pulse length, ms
+ *
+ * The datasheet says you need 10 us, but 1 ms works just fine.
+ */
+#define SONAR_TRIG_MS 1
+
+/** ..., and at least this long when the systick catches up (ticks close together), Timer1 ticks */
+#define SONAR_TRIG_MIN_TICKS (10 * ECHO_TICKS_PER_US)
+
+/** Echo width reported when there's no echo in range, Timer1 ticks (7.5 ms) */
+#define SONAR_TIMEOUT 15000
+
+/** Longest wait for the echo pulse to start after the trigger, us */
+#ifndef SONAR_RISE_US
+#define SONAR_RISE_US 1500
+#endif
+
+#define SONAR_RISE_TICKS ((uint16_t)(SONAR_RISE_US * ECHO_TICKS_PER_US))
+
+/** Echo width of a distance, Timer1 ticks (58 us per cm there and back) */
+#define SONAR_CM_TICKS(cm) ((uint16_t)((cm) * 58UL * ECHO_TICKS_PER_US))
+
+/** Longest listen window of a sensor gated at max_cm, ms */
+#define SONAR_LISTEN_MS(max_cm) \
+	((SONAR_RISE_TICKS + SONAR_CM_TICKS(max_cm) + ECHO_TICKS_PER_US * 1000 - 1) \
+	 / (ECHO_TICKS_PER_US * 1000))
+
+/**
+ * Longest quiet gap after a sensor timed out with its echo still high, ms
+ *
+ * The sensors that can hear it wait this long for its ping to come back
+ * or die out. It used to be a fixed delay before each sensor.
+ */
+#ifndef SONAR_GAP_MS
+#define SONAR_GAP_MS 6
+#endif
+
+/** Longest time spent on one sensor, ms (trigger, a timed out listen window and the gap) */
+#define SONAR_SENSOR_MS(max_cm) (SONAR_TRIG_MS + SONAR_LISTEN_MS(max_cm) + SONAR_GAP_MS)
+
+#define _SONAR_SENSOR_MS(trig, echo, sens, avg, r, g, b, min, max, dir) + SONAR_SENSOR_MS(max)
+
+/** Longest possible frame, ms (+1 for the tick that starts it) - all sensors in turn */
+#define SONAR_WORST_FRAME_MS (1 SENSORS(_SONAR_SENSOR_MS))
+
+/**
+ * ..., as it used to be: a SONAR_GAP_MS quiet gap before each sensor
+ * and waiting the whole SONAR_TIMEOUT
+ */
+#define SONAR_UNGATED_FRAME_MS (1 + SONAR_COUNT * (SONAR_GAP_MS + SONAR_TRIG_MS + \
+	(SONAR_TIMEOUT + ECHO_TICKS_PER_US * 1000 - 1) / (ECHO_TICKS_PER_US * 1000)))
+
+/** Worst-case time per frame saved by the range gates and the scheduling, ms */
+#define SONAR_SAVED_MS (SONAR_UNGATED_FRAME_MS - SONAR_WORST_FRAME_MS)
+
+/** Frame rate (frames per second) - 20, or less if a frame can take longer than that */
+#ifndef SONAR_FPS
+#define SONAR_FPS (SONAR_WORST_FRAME_MS <= 1000 / 20 ? 20 : 1000 / SONAR_WORST_FRAME_MS)
+#endif
+
+/** Frame period in ms */
+#define SONAR_FRAME_MS (1000 / SONAR_FPS)
+
+/** A finished frame */
+typedef struct {
+	uint16_t echo[SONAR_COUNT]; // echo widths (Timer1 ticks)
+	uint16_t start_ms; // systick time the frame started
+	uint8_t duration_ms; // time it took to measure all sensors
+	bool missed; // the frame missed its deadline
+	uint8_t xtalk; // sensors whose echo was dropped as cross-talk (bit mask)
+} SonarFrame;
+
+/** Add a sensor with its range gate (must be used with constant args) */
+#define sonar_add(trig_pin, echo_pin, min_cm, max_cm, dir) \
+	sonar_add_do((trig_pin), echo_add(echo_pin), SONAR_CM_TICKS(min_cm), SONAR_CM_TICKS(max_cm), (dir))
+
+/** Set up the echo pins and add all sensors from sensors.h */
+#define _SONAR_ADD(trig, echo, sens, avg, r, g, b, min, max, dir) as_input_pu(echo); sonar_add(trig, echo, min, max, dir);
+#define sonar_add_all() do { SENSORS(_SONAR_ADD) } while (0)
+
+/**
+ * Add a sensor (low level function)
+ *
+ * min, max: range gate, echo widths in Timer1 ticks
+ * dir: direction the sensor faces, degrees
+ */
+uint8_t sonar_add_do(uint8_t trig_pin, uint8_t echo_ch, uint16_t min, uint16_t max, int16_t dir);
+
+/** Start the scheduler. Call after all sonar_add()s. */
+void sonar_init(void);
+
+/** Check if there's a finished frame to take */
+bool sonar_ready(void);
+
+/**
+ * Check if an echo is being timed
+ *
+ * The pin-change interrupts timestamp the echo edges - anything keeping
+ * the interrupts disabled meanwhile (eg. a bit-banged LED frame) makes
+ * the echo look longer or shorter.
+ */
+bool sonar_listening(void);
+
+/** Get a finished frame. Returns false if there's none yet. */
+bool sonar_take(SonarFrame *frame);
+
+/** Number of frames that missed the deadline so far */
+uint16_t sonar_missed_count(void);
+
+/** Number of echoes dropped as cross-talk so far */
+uint16_t sonar_xtalk_count(void);
+
+/** Number of sensors added */
+uint8_t sonar_count(void);
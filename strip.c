@@ -0,0 +1,313 @@
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lib/calc.h"
+#include "lib/systick.h"
+#include "ws2812.h"
+#include "ws2812_timing.h"
+#include "gamma.h"
+#include "strip.h"
+
+/** Index of the newest sample in the history ring buffer */
+static uint16_t history_head = 0;
+
+#if STRIP_PACKED
+
+/** Color samples, 4 bits per color - sample i is in history[i / 2], low nibbles for even i */
+static RGB history[(STRIP_SAMPLES + 1) / 2];
+
+/** 8-bit value to 4 bits (rounded) */
+#define PACK4(v) ((uint8_t)(((v) + 8) / 17))
+
+/** 4 bits back to 8 (0xF -> 0xFF) */
+#define UNPACK4(n) ((uint8_t)((n) * 17))
+
+
+/** Put a color to the history */
+static inline void history_set(uint16_t i, uint8_t r, uint8_t g, uint8_t b)
+{
+	RGB *pair = &history[i >> 1];
+
+	if (i & 1) {
+		pair->r = (uint8_t)((pair->r & 0x0F) | (PACK4(r) << 4));
+		pair->g = (uint8_t)((pair->g & 0x0F) | (PACK4(g) << 4));
+		pair->b = (uint8_t)((pair->b & 0x0F) | (PACK4(b) << 4));
+	} else {
+		pair->r = (uint8_t)((pair->r & 0xF0) | PACK4(r));
+		pair->g = (uint8_t)((pair->g & 0xF0) | PACK4(g));
+		pair->b = (uint8_t)((pair->b & 0xF0) | PACK4(b));
+	}
+}
+
+
+/** Get a color from the history */
+static inline RGB history_get(uint16_t i)
+{
+	RGB pair = history[i >> 1];
+	RGB c;
+
+	if (i & 1) {
+		pair.r >>= 4;
+		pair.g >>= 4;
+		pair.b >>= 4;
+	}
+
+	c.r = UNPACK4(pair.r & 0x0F);
+	c.g = UNPACK4(pair.g & 0x0F);
+	c.b = UNPACK4(pair.b & 0x0F);
+	return c;
+}
+
+#else
+
+/** Color samples */
+static RGB history[STRIP_SAMPLES];
+
+
+/** Put a color to the history */
+static inline void history_set(uint16_t i, uint8_t r, uint8_t g, uint8_t b)
+{
+	history[i].r = r;
+	history[i].g = g;
+	history[i].b = b;
+}
+
+
+/** Get a color from the history */
+static inline RGB history_get(uint16_t i)
+{
+	return history[i];
+}
+
+#endif
+
+
+/** Scroll the strip by one sample and put a new color to the first LED */
+void strip_push(uint8_t r, uint8_t g, uint8_t b)
+{
+	// scroll by moving the head back
+	dec_wrap(history_head, 0, STRIP_SAMPLES);
+
+	history_set(history_head, r, g, b);
+}
+
+
+#if STRIP_DITHER
+/** Counts the frames sent, for the dithering */
+static uint8_t frame_count;
+#endif
+
+
+/** Gamma-correct (and dither) the color of a LED, right before it's sent */
+static inline RGB output_color(RGB c, uint16_t led)
+{
+#if STRIP_DITHER
+	uint8_t thr = gamma_dither(frame_count, led);
+#else
+	uint8_t thr = GAMMA_ROUND;
+	(void) led;
+#endif
+
+	c.r = gamma_apply(c.r, thr);
+	c.g = gamma_apply(c.g, thr);
+	c.b = gamma_apply(c.b, thr);
+	return c;
+}
+
+
+// The LED colors are generated one by one, as they are sent.
+//
+// LED i shows the history at position i / STRIP_SPREAD + (1 - phase / 256)
+// samples from the newest one; between two samples, the colors are
+// interpolated linearly. Positions are tracked in 1/256 LED units,
+// a sample is 256 * STRIP_SPREAD of them.
+
+/** Sample length in position units */
+#define SAMPLE_UNITS (256U * STRIP_SPREAD)
+
+_Static_assert(STRIP_SPREAD >= 1 && STRIP_SPREAD <= 255, "STRIP_SPREAD must be 1..255");
+
+/** Pixel generator state */
+typedef struct {
+	uint16_t sample; // history index of the sample before the position
+	uint16_t rem;    // position past that sample, 0..SAMPLE_UNITS-1
+	RGB a, b;        // the sample and the next (older) one
+} Render;
+
+
+/** Load the samples around the position */
+static void render_load(Render *it)
+{
+	uint16_t next = it->sample;
+	inc_wrap(next, 0, STRIP_SAMPLES);
+
+	it->a = history_get(it->sample);
+	it->b = history_get(next);
+}
+
+
+/** Start at the first LED */
+static void render_start(Render *it, uint16_t phase)
+{
+	uint16_t offset = (uint16_t)((STRIP_PHASE_END - phase) * STRIP_SPREAD);
+
+	it->sample = history_head;
+	if (offset >= SAMPLE_UNITS) {
+		inc_wrap(it->sample, 0, STRIP_SAMPLES);
+		offset -= SAMPLE_UNITS;
+	}
+	it->rem = offset;
+
+	render_load(it);
+}
+
+
+#if WS_BACKEND == WS_BACKEND_PARALLEL
+/** Move ahead by a number of LEDs */
+static void render_skip(Render *it, uint16_t leds)
+{
+	uint32_t pos = it->rem + (uint32_t) leds * 256;
+
+	it->sample = (uint16_t)((it->sample + pos / SAMPLE_UNITS) % STRIP_SAMPLES);
+	it->rem = (uint16_t)(pos % SAMPLE_UNITS);
+
+	render_load(it);
+}
+#endif
+
+
+/** Interpolate between two values, f = 0..255 */
+static inline uint8_t lerp8(uint8_t a, uint8_t b, uint8_t f)
+{
+	// a + (b - a) * f / 256, rounded; at most 255 * 256 + 128, fits in 16 bits unsigned
+	return (uint8_t)(((uint16_t) a * (uint16_t)(256 - f) + (uint16_t) b * f + 128) >> 8);
+}
+
+
+/** Get the next LED's color */
+static RGB render_next(Render *it)
+{
+	RGB c;
+
+	// position within the sample, 0..255
+#if STRIP_SPREAD > 1
+	uint8_t f = (uint8_t)(((uint32_t) it->rem * (65536UL / STRIP_SPREAD)) >> 16);
+#else
+	uint8_t f = (uint8_t) it->rem;
+#endif
+
+	if (f == 0) {
+		c = it->a;
+	} else {
+		c.r = lerp8(it->a.r, it->b.r, f);
+		c.g = lerp8(it->a.g, it->b.g, f);
+		c.b = lerp8(it->a.b, it->b.b, f);
+	}
+
+	it->rem += 256;
+	if (it->rem >= SAMPLE_UNITS) {
+		it->rem -= SAMPLE_UNITS;
+		inc_wrap(it->sample, 0, STRIP_SAMPLES);
+		render_load(it);
+	}
+
+	return c;
+}
+
+
+#if WS_BACKEND == WS_BACKEND_PARALLEL
+
+// The strip is split into WS_LANES strips of equal length, driven at once
+// - strip 1 continues where strip 0 ends, and so on.
+
+/** LEDs per strip */
+#define LANE_LEDS (LED_COUNT / WS_LANES)
+
+_Static_assert(LED_COUNT % WS_LANES == 0, "LED_COUNT must be a multiple of WS_LANES");
+
+/** Send the strip contents to the LEDs, scrolled by a phase */
+void strip_render(uint16_t phase)
+{
+	Render its[WS_LANES];
+	uint8_t slots[WS_SLOTS];
+
+	// a generator per strip, starting at its first LED
+	render_start(&its[0], phase);
+	for (uint8_t lane = 1; lane < WS_LANES; lane++) {
+		its[lane] = its[lane - 1];
+		render_skip(&its[lane], LANE_LEDS);
+	}
+
+	// each LED position is computed and transposed right before it's sent,
+	// while the lines are low - that has to take less than the reset time
+	ws_begin();
+	for (uint16_t pos = 0; pos < LANE_LEDS; pos++) {
+		memset(slots, 0, sizeof(slots));
+
+		for (uint8_t lane = 0; lane < WS_LANES; lane++) {
+			RGB c = output_color(render_next(&its[lane]), lane * LANE_LEDS + pos);
+			ws_par_set(slots, lane, c.r, c.g, c.b);
+		}
+
+		ws_par_send(slots);
+	}
+
+#if STRIP_DITHER
+	frame_count++;
+#endif
+
+	ws_show();
+}
+
+#else
+
+/** Send the strip contents to the LEDs, scrolled by a phase */
+void strip_render(uint16_t phase)
+{
+	Render it;
+
+	// each color is computed between the LEDs, while the line is low
+	render_start(&it, phase);
+	ws_begin();
+	for (uint16_t i = 0; i < LED_COUNT; i++) {
+		RGB c = output_color(render_next(&it), i);
+		ws_send_rgb(c.r, c.g, c.b);
+	}
+
+#if STRIP_DITHER
+	frame_count++;
+#endif
+
+	ws_show();
+}
+
+#endif
+
+
+#if WS_BACKEND != WS_BACKEND_SPI
+
+// The CPU-timed backends send a frame with interrupts off, and the systick
+// catches up on the ms missed meanwhile - if it's SYSTICK_CATCHUP_MS at most.
+// The bits alone may take 3/4 of that, the rest is left for computing the
+// colors between the LEDs (not measured yet, see the README).
+
+#if WS_BACKEND == WS_BACKEND_PARALLEL
+#define FRAME_LEDS LANE_LEDS
+#define LED_CYCLES (24 * WS_PAR_TBIT(F_CPU))
+#else
+#define FRAME_LEDS LED_COUNT
+#define LED_CYCLES (24 * WS_BB_TBIT(F_CPU))
+#endif
+
+_Static_assert(FRAME_LEDS * LED_CYCLES * 4 <= SYSTICK_CATCHUP_MS * 3 * (F_CPU / 1000),
+               "LED frame too long for the systick to catch up - fewer LEDs, more WS_LANES or the SPI backend");
+
+#endif
+
+
+/** Send the strip contents to the LEDs */
+void strip_show(void)
+{
+	strip_render(STRIP_PHASE_END);
+}
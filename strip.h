@@ -0,0 +1,87 @@
+#pragma once
+
+//
+//  LED strip contents - a scrolling history of colors.
+//
+//  New colors enter at the first LED and move further with every
+//  strip_push(). Only the color samples are stored - the LED colors
+//  are computed from them as they are sent out, so with STRIP_SPREAD
+//  LEDs per sample, a long strip needs little RAM.
+//
+
+#include <stdint.h>
+
+/** Number of LEDs in your strip */
+#ifndef LED_COUNT
+#define LED_COUNT 30
+#endif
+
+/**
+ * LEDs per color sample
+ *
+ * 1 = every LED shows one sample, the strip scrolls by one LED per frame.
+ * With more, the colors between samples are interpolated, and the strip
+ * scrolls by STRIP_SPREAD LEDs per frame.
+ */
+#ifndef STRIP_SPREAD
+#define STRIP_SPREAD 1
+#endif
+
+/** Number of stored samples (two more for interpolating when scrolled by a phase) */
+#define STRIP_SAMPLES ((LED_COUNT - 1) / STRIP_SPREAD + 3)
+
+/**
+ * Store the history with 4 bits per color (16 levels) instead of 8
+ *
+ * That halves the RAM needed per LED (1.5 bytes instead of 3), for long
+ * strips - see STRIP_HISTORY_BYTES. The rest of the 2 KB is taken by the
+ * other static data and the stack; `make ram-report` prints the static
+ * RAM of builds with and without packing (bit-bang and parallel backend),
+ * to find the longest strip that still leaves room for the stack.
+ */
+#ifndef STRIP_PACKED
+#define STRIP_PACKED 0
+#endif
+
+/**
+ * Temporal dithering of the gamma-corrected output (see gamma.h)
+ *
+ * Gives smoother fades at the dark end, but only looks good when the
+ * strip is refreshed often (RENDER_HZ, see render.h) - at the sonar
+ * frame rate it flickers.
+ */
+#ifndef STRIP_DITHER
+#define STRIP_DITHER 0
+#endif
+
+/** RAM taken by the history, bytes */
+#if STRIP_PACKED
+#define STRIP_HISTORY_BYTES (((STRIP_SAMPLES + 1) / 2) * 3)
+#else
+#define STRIP_HISTORY_BYTES (STRIP_SAMPLES * 3)
+#endif
+
+/** RGB color structure */
+typedef struct __attribute__((packed)) {
+	uint8_t r;
+	uint8_t g;
+	uint8_t b;
+} RGB;
+
+/** Scroll the strip by one sample and put a new color to the first LED */
+void strip_push(uint8_t r, uint8_t g, uint8_t b);
+
+/** Phase of a fully scrolled strip (see strip_render) */
+#define STRIP_PHASE_END 256
+
+/**
+ * Send the strip contents to the LEDs, scrolled by a phase
+ *
+ * The phase (0..STRIP_PHASE_END) is how far the strip has scrolled
+ * towards the newest sample - for a smooth scroll between strip_push()es.
+ * At 0, the first LED shows the sample before the newest one.
+ */
+void strip_render(uint16_t phase);
+
+/** Send the strip contents to the LEDs (fully scrolled) */
+void strip_show(void);
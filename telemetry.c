@@ -0,0 +1,98 @@
+#include <avr/io.h>
+#include <util/crc16.h>
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lib/usart.h"
+#include "sonar.h"
+#include "telemetry.h"
+
+/** Longest payload */
+#define TELEM_MAX_PAYLOAD (8 + SONAR_COUNT * 3)
+
+static uint8_t seq = 0;
+static uint8_t dropped = 0;
+
+#if TELEM_DECIMATE > 1
+static uint8_t decimate = 0;
+#endif
+
+/** Packet being built */
+static uint8_t pkt[4 + TELEM_MAX_PAYLOAD + 2];
+static uint8_t pkt_len;
+
+
+/** Start a packet */
+static void pkt_begin(uint8_t type)
+{
+	pkt[0] = TELEM_SYNC;
+	pkt[1] = type;
+	pkt[2] = seq++;
+	pkt_len = 4;
+}
+
+
+static void pkt_u8(uint8_t b)
+{
+	pkt[pkt_len++] = b;
+}
+
+
+static void pkt_u16(uint16_t w)
+{
+	pkt[pkt_len++] = (uint8_t) w;
+	pkt[pkt_len++] = (uint8_t)(w >> 8);
+}
+
+
+/** Fill in length and CRC and queue the packet */
+static void pkt_send(void)
+{
+	pkt[3] = (uint8_t)(pkt_len - 4);
+
+	uint16_t crc = 0xFFFF;
+	for (uint8_t i = 1; i < pkt_len; i++) {
+		crc = _crc_ccitt_update(crc, pkt[i]);
+	}
+	pkt_u16(crc);
+
+	if (!usart_try_write(pkt, pkt_len)) {
+		dropped++;
+	}
+}
+
+
+/** Send a frame packet */
+void telem_frame(const SonarFrame *frame, const uint8_t *values)
+{
+	if (TELEM_DECIMATE == 0) {
+		return;
+	}
+
+#if TELEM_DECIMATE > 1
+	if (++decimate < TELEM_DECIMATE) {
+		return;
+	}
+	decimate = 0;
+#endif
+
+	uint8_t n = sonar_count();
+
+	pkt_begin(TELEM_FRAME);
+	pkt_u16(frame->start_ms);
+	pkt_u8(frame->duration_ms);
+	pkt_u8((frame->missed ? 1 : 0) | (frame->xtalk ? 2 : 0));
+	pkt_u16(sonar_missed_count());
+	pkt_u8(dropped);
+	pkt_u8(n);
+
+	for (uint8_t i = 0; i < n; i++) {
+		pkt_u16(frame->echo[i]);
+	}
+
+	for (uint8_t i = 0; i < n; i++) {
+		pkt_u8(values[i]);
+	}
+
+	pkt_send();
+}
@@ -0,0 +1,56 @@
+#pragma once
+
+//
+//  Binary telemetry stream over the USART.
+//
+//  Every TELEM_DECIMATE-th sonar frame is sent as a packet:
+//
+//    0xA5 | type | seq | len | payload (len bytes) | crc16
+//
+//  - seq increments with every packet (also dropped ones),
+//    so gaps show lost packets
+//  - crc16 is CRC-CCITT as computed by _crc_ccitt_update() from
+//    avr-libc, starting at 0xFFFF, over type..payload; little endian
+//  - all multi-byte fields are little endian
+//
+//  Payload of TELEM_FRAME:
+//
+//    u16 start_ms      frame start (systick ms)
+//    u8  duration_ms   time spent measuring
+//    u8  flags         bit 0 = missed deadline, bit 1 = an echo was
+//                      dropped as cross-talk
+//    u16 missed        missed deadlines so far
+//    u8  dropped       packets dropped because the TX buffer was full
+//    u8  n             number of sensors
+//    u16 echo[n]       raw echo widths (Timer1 ticks, 0.5 us at 16 MHz)
+//    u8  value[n]      filtered channel values
+//
+//  Packets are queued without waiting; when there's no room in the TX
+//  buffer, the packet is dropped. Use tools/telemetry.py to decode them.
+//
+
+#include <stdbool.h>
+#include <stdint.h>
+
+#include "lib/usart.h"
+#include "sonar.h"
+
+/** Send telemetry every N-th frame, 0 = off */
+#ifndef TELEM_DECIMATE
+#define TELEM_DECIMATE 0
+#endif
+
+/** Baud rate when telemetry is on (UBRR value) */
+#ifndef TELEM_BAUD
+#define TELEM_BAUD BAUD_500k
+#endif
+
+#define TELEM_SYNC 0xA5
+
+/** Packet types */
+enum {
+	TELEM_FRAME = 0x01,
+};
+
+/** Send a frame packet (respecting TELEM_DECIMATE) */
+void telem_frame(const SonarFrame *frame, const uint8_t *values);
@@ -0,0 +1,168 @@
+#!/usr/bin/env python3
+"""
+Decoder / recorder for the binary telemetry stream (see telemetry.h).
+
+Usage:
+    telemetry.py /dev/ttyUSB0 [-b 500000] [-o record.csv]   # live, needs pyserial
+    telemetry.py -f capture.bin [-o record.csv]              # decode a raw capture
+    telemetry.py /dev/ttyUSB0 --raw capture.bin              # record raw bytes too
+
+Each decoded frame is printed as one line; with -o, it's also written as CSV.
+Lost packets (sequence gaps) and CRC errors are reported on stderr.
+"""
+
+import argparse
+import struct
+import sys
+
+SYNC = 0xA5
+TELEM_FRAME = 0x01
+
+# packets must fit in the firmware's TX buffer (USART_TX_BUF_LEN)
+MAX_PAYLOAD = 64 - 6
+
+
+def crc_ccitt_update(crc, data):
+    """Same as _crc_ccitt_update() from avr-libc <util/crc16.h>"""
+    data ^= crc & 0xFF
+    data ^= (data << 4) & 0xFF
+    return ((((data << 8) | (crc >> 8)) ^ (data >> 4) ^ (data << 3)) & 0xFFFF)
+
+
+def crc16(data):
+    crc = 0xFFFF
+    for b in data:
+        crc = crc_ccitt_update(crc, b)
+    return crc
+
+
+class Decoder:
+    """Splits the byte stream into packets, resyncing on errors"""
+
+    def __init__(self):
+        self.buf = bytearray()
+        self.last_seq = None
+        self.crc_errors = 0
+        self.lost = 0
+
+    def feed(self, data):
+        self.buf += data
+        packets = []
+
+        while True:
+            start = self.buf.find(bytes([SYNC]))
+            if start < 0:
+                self.buf.clear()
+                break
+            del self.buf[:start]
+
+            if len(self.buf) < 4:
+                break
+            length = self.buf[3]
+            if length > MAX_PAYLOAD:
+                del self.buf[:1]
+                continue
+
+            total = 4 + length + 2
+            if len(self.buf) < total:
+                break
+
+            body = bytes(self.buf[1:4 + length])
+            (crc,) = struct.unpack_from('<H', self.buf, 4 + length)
+            if crc16(body) != crc:
+                # not a packet start (or corrupted), skip the sync byte
+                self.crc_errors += 1
+                del self.buf[:1]
+                continue
+
+            del self.buf[:total]
+            ptype, seq = body[0], body[1]
+
+            if self.last_seq is not None:
+                gap = (seq - self.last_seq - 1) & 0xFF
+                if gap:
+                    self.lost += gap
+                    print('! lost %d packet(s) before seq %d' % (gap, seq), file=sys.stderr)
+            self.last_seq = seq
+
+            packets.append((ptype, seq, body[3:]))
+
+        return packets
+
+
+def parse_frame(payload):
+    start_ms, duration_ms, flags, missed, dropped, n = struct.unpack_from('<HBBHBB', payload, 0)
+    echo = list(struct.unpack_from('<%dH' % n, payload, 8))
+    values = list(payload[8 + 2 * n:8 + 3 * n])
+    return {
+        'start_ms': start_ms,
+        'duration_ms': duration_ms,
+        'missed_now': flags & 1,
+        'xtalk': (flags >> 1) & 1,
+        'missed': missed,
+        'dropped': dropped,
+        'echo': echo,
+        'value': values,
+    }
+
+
+def main():
+    ap = argparse.ArgumentParser(description='Spatial RGB telemetry decoder')
+    ap.add_argument('port', nargs='?', help='serial port')
+    ap.add_argument('-b', '--baud', type=int, default=500000)
+    ap.add_argument('-f', '--file', help='decode a raw capture instead of a port')
+    ap.add_argument('-o', '--csv', help='write decoded frames to a CSV file')
+    ap.add_argument('--raw', help='also save the raw stream to a file')
+    args = ap.parse_args()
+
+    if args.file:
+        src = open(args.file, 'rb')
+        read = lambda: src.read(4096)
+    elif args.port:
+        import serial
+        src = serial.Serial(args.port, args.baud, timeout=0.1)
+        read = lambda: src.read(src.in_waiting or 1)
+    else:
+        ap.error('give a serial port or -f FILE')
+
+    raw = open(args.raw, 'wb') if args.raw else None
+    csv = open(args.csv, 'w') if args.csv else None
+    header_done = False
+
+    dec = Decoder()
+    try:
+        while True:
+            data = read()
+            if args.file and not data:
+                break
+            if raw:
+                raw.write(data)
+
+            for ptype, seq, payload in dec.feed(data):
+                if ptype != TELEM_FRAME:
+                    continue
+
+                f = parse_frame(payload)
+                n = len(f['echo'])
+                print('#%3d t=%5d dur=%2d ms%s%s echo=%s value=%s' % (
+                    seq, f['start_ms'], f['duration_ms'], ' MISSED' if f['missed_now'] else '',
+                    ' XTALK' if f['xtalk'] else '',
+                    f['echo'], f['value']))
+
+                if csv:
+                    if not header_done:
+                        cols = ['seq', 'start_ms', 'duration_ms', 'missed_now', 'xtalk', 'missed', 'dropped']
+                        cols += ['echo%d' % i for i in range(n)] + ['value%d' % i for i in range(n)]
+                        csv.write(','.join(cols) + '\n')
+                        header_done = True
+                    row = [seq, f['start_ms'], f['duration_ms'], f['missed_now'], f['xtalk'], f['missed'], f['dropped']]
+                    row += f['echo'] + f['value']
+                    csv.write(','.join(str(x) for x in row) + '\n')
+    except KeyboardInterrupt:
+        pass
+
+    print('crc errors: %d, lost packets: %d' % (dec.crc_errors, dec.lost), file=sys.stderr)
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,161 @@
+#!/usr/bin/env python3
+"""
+Decode WS2812 waveforms from a VCD trace back into pixel colors.
+
+Meant for checking the LED output in simavr, eg. the parallel backend
+(WS_BACKEND = 2) with the strips on PORTC:
+
+    simavr -m atmega328p -f 16000000 -o ws.vcd \\
+        --add-vcd-trace portc=trace@0x28/0x3f bench/bench.elf
+    tools/ws_decode.py ws.vcd
+
+Every bit of every traced signal is decoded as one strip: pulses longer
+than --threshold ns are '1', shorter ones '0', and a low time longer than
+--reset us ends a frame. Each frame is printed as one line per strip:
+
+    frame 0 portc[0]: 30 LEDs  00102030 ...
+
+(colors as RRGGBB hex, the bytes are sent in GRB order).
+"""
+
+import argparse
+import sys
+
+TIMESCALES = {'s': 1e9, 'ms': 1e6, 'us': 1e3, 'ns': 1.0, 'ps': 1e-3, 'fs': 1e-6}
+
+
+def parse_vcd(f):
+    """Yields ('signals', {id: (name, width)}) after the header, then (time_ns, id, value) changes"""
+    signals = {}  # id -> (name, width)
+    scale = 1.0
+    header = True
+    time = 0
+    words = iter(f.read().split())
+
+    for w in words:
+        if header:
+            if w == '$timescale':
+                ts = ''
+                for t in words:
+                    if t == '$end':
+                        break
+                    ts += t
+                num = ''.join(c for c in ts if c.isdigit()) or '1'
+                unit = ts[len(num):]
+                scale = int(num) * TIMESCALES[unit]
+            elif w == '$var':
+                fields = []
+                for t in words:
+                    if t == '$end':
+                        break
+                    fields.append(t)
+                # type width id name [range]
+                signals[fields[2]] = (fields[3], int(fields[1]))
+            elif w == '$enddefinitions':
+                header = False
+                yield ('signals', signals)
+            continue
+
+        if w[0] == '#':
+            time = int(w[1:]) * scale
+        elif w[0] in 'bB':
+            val = w[1:]
+            ident = next(words)
+            yield (time, ident, int(val.replace('x', '0').replace('z', '0'), 2))
+        elif w[0] in '01xzXZ' and len(w) > 1:
+            yield (time, w[1:], 1 if w[0] == '1' else 0)
+        # $dumpvars etc. are ignored
+
+
+class Lane:
+    """Decoder of one data line"""
+
+    def __init__(self, name, threshold_ns, reset_ns):
+        self.name = name
+        self.threshold = threshold_ns
+        self.reset = reset_ns
+        self.level = 0
+        self.rise = None
+        self.fall = None
+        self.bits = []
+        self.frames = []
+
+    def edge(self, t, level):
+        if level == self.level:
+            return
+        self.level = level
+        if level:
+            if self.fall is not None and t - self.fall > self.reset:
+                self.end_frame()
+            self.rise = t
+        else:
+            if self.rise is not None:
+                self.bits.append(1 if t - self.rise > self.threshold else 0)
+            self.fall = t
+
+    def end_frame(self):
+        if self.bits:
+            self.frames.append(self.bits)
+        self.bits = []
+
+    def colors(self, bits):
+        leds = []
+        for i in range(0, len(bits) - 23, 24):
+            v = [int(''.join(str(b) for b in bits[i + 8 * k:i + 8 * k + 8]), 2) for k in range(3)]
+            g, r, b = v
+            leds.append((r, g, b))
+        return leds
+
+
+def main():
+    ap = argparse.ArgumentParser(description=__doc__, formatter_class=argparse.RawDescriptionHelpFormatter)
+    ap.add_argument('vcd', help='VCD trace file')
+    ap.add_argument('--threshold', type=float, default=600, help="'1' pulse threshold, ns (600)")
+    ap.add_argument('--reset', type=float, default=50, help='reset (latch) time, us (50)')
+    args = ap.parse_args()
+
+    lanes = {}  # (id, bit) -> Lane
+    values = {}  # id -> last value
+
+    with open(args.vcd) as f:
+        for ev in parse_vcd(f):
+            if ev[0] == 'signals':
+                for ident, (name, width) in ev[1].items():
+                    values[ident] = 0
+                    for bit in range(width):
+                        lname = '%s[%d]' % (name, bit) if width > 1 else name
+                        lanes[(ident, bit)] = Lane(lname, args.threshold, args.reset * 1000)
+                continue
+
+            t, ident, val = ev
+            if ident not in values:
+                continue
+            values[ident] = val
+            bit = 0
+            while (ident, bit) in lanes:
+                lanes[(ident, bit)].edge(t, (val >> bit) & 1)
+                bit += 1
+
+    for lane in lanes.values():
+        lane.end_frame()
+
+    nframes = max((len(l.frames) for l in lanes.values()), default=0)
+    for n in range(nframes):
+        for lane in lanes.values():
+            if n >= len(lane.frames):
+                continue
+            bits = lane.frames[n]
+            leds = lane.colors(bits)
+            extra = ' (+%d bits)' % (len(bits) % 24) if len(bits) % 24 else ''
+            print('frame %d %s: %d LEDs%s  %s' % (
+                n, lane.name, len(leds), extra,
+                ' '.join('%02x%02x%02x' % c for c in leds)))
+
+    if nframes == 0:
+        print('no WS2812 data found', file=sys.stderr)
+        return 1
+    return 0
+
+
+if __name__ == '__main__':
+    sys.exit(main())
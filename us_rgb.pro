@@ -21,14 +21,44 @@ HEADERS += \
 	lib/usart.h \
 	lib/nsdelay.h \
 	lib/spi.h \
-    lib/debounce.h
+    lib/debounce.h \
+	lib/echo.h \
+	lib/systick.h \
+	lib/mbuf.h \
+	lib/median.h \
+	lib/track.h \
+	sonar.h \
+	ws2812.h \
+	ws2812_timing.h \
+	telemetry.h \
+	pipeline.h \
+	sensors.h \
+	strip.h \
+	gamma.h \
+	render.h \
+	prof.h \
+	idle.h
 
 SOURCES += \
 	lib/iopins.c \
 	main.c \
 	lib/usart.c \
 	lib/spi.c \
-    lib/debounce.c
+    lib/debounce.c \
+	lib/echo.c \
+	lib/systick.c \
+	lib/mbuf.c \
+	lib/median.c \
+	lib/track.c \
+	sonar.c \
+	ws2812.c \
+	telemetry.c \
+	pipeline.c \
+	strip.c \
+	gamma.c \
+	render.c \
+	prof.c \
+	idle.c
 
 # === Flags for the Clang code model===
 #
@@ -0,0 +1,271 @@
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <util/delay.h>
+#include <util/atomic.h>
+#include <stdbool.h>
+#include <stdint.h>
+#include <string.h>
+
+#include "lib/calc.h"
+#include "lib/iopins.h"
+#include "lib/spi.h"
+#include "lib/nsdelay.h"
+#include "ws2812.h"
+#include "ws2812_timing.h"
+
+#if WS_BACKEND == WS_BACKEND_BITBANG
+
+// The bit timing is generated by cycle-counted assembly.
+// The delays are computed from F_CPU (see ws2812_timing.h for the
+// loop), so there's nothing to tune by hand.
+
+#define WS_W1 WS_BB_W1(F_CPU)
+#define WS_W2 WS_BB_W2(F_CPU)
+#define WS_W3 WS_BB_W3(F_CPU)
+
+/** Resulting pulse widths, ns */
+#define WS_T0H_REAL cycles2ns(WS_BB_T0H(F_CPU))
+#define WS_T1H_REAL cycles2ns(WS_BB_T1H(F_CPU))
+
+_Static_assert(WS_TIMING_OK(WS_BB_T0H(F_CPU), WS_BB_T1H(F_CPU), WS_BB_TBIT(F_CPU), F_CPU),
+               "WS2812 low time or bit period out of spec at this F_CPU");
+
+/** Port register and bit of a pin (expands the pin macro first) */
+#define WS_PORT_OF(pin) _port(pin)
+#define WS_BIT_OF(pin) _pn(pin)
+
+/** Send one byte to the RGB strip. hi/lo are the port values. Interrupts must be off. */
+static inline  __attribute__((always_inline))
+void ws_send_byte(uint8_t bb, uint8_t hi, uint8_t lo)
+{
+	uint8_t cnt;
+
+	__asm__ volatile(
+		"	ldi  %[cnt], 8       \n"
+		"1:	out  %[port], %[hi]  \n"
+		"	.rept %[w1]          \n"
+		"	nop                  \n"
+		"	.endr                \n"
+		"	sbrs %[bb], 7        \n"
+		"	out  %[port], %[lo]  \n"
+		"	lsl  %[bb]           \n"
+		"	.rept %[w2]          \n"
+		"	nop                  \n"
+		"	.endr                \n"
+		"	out  %[port], %[lo]  \n"
+		"	.rept %[w3]          \n"
+		"	nop                  \n"
+		"	.endr                \n"
+		"	dec  %[cnt]          \n"
+		"	brne 1b              \n"
+		: [cnt] "=&d" (cnt),
+		  [bb] "+r" (bb)
+		: [port] "I" (_SFR_IO_ADDR(WS_PORT_OF(WS_PIN))),
+		  [hi] "r" (hi),
+		  [lo] "r" (lo),
+		  [w1] "n" (WS_W1),
+		  [w2] "n" (WS_W2),
+		  [w3] "n" (WS_W3)
+	);
+}
+
+
+/** Init the output pin */
+void ws_init(void)
+{
+	as_output(WS_PIN);
+}
+
+
+/** Send a RGB color to the strip */
+void ws_send_rgb(uint8_t r, uint8_t g, uint8_t b)
+{
+	// An interrupt in the middle of a bit would corrupt it.
+	// It also must not change the port while we write it as a whole.
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		uint8_t hi = WS_PORT_OF(WS_PIN) | (1 << WS_BIT_OF(WS_PIN));
+		uint8_t lo = WS_PORT_OF(WS_PIN) & ~(1 << WS_BIT_OF(WS_PIN));
+
+		ws_send_byte(g, hi, lo);
+		ws_send_byte(r, hi, lo);
+		ws_send_byte(b, hi, lo);
+	}
+}
+
+#elif WS_BACKEND == WS_BACKEND_SPI
+
+// The SPI runs at F_CPU/2, one SPI byte encodes one data bit.
+// The pulse starts with the MSB, the rest of the bit period is low
+// (the line stays low between bytes, too).
+
+/** SPI bit length in ns */
+#define WS_SPI_BIT_NS (2000000000UL / F_CPU)
+
+/** Number of high SPI bits for a given pulse width, 1..7 */
+#define WS_SPI_BITS(ns) \
+	(((ns) + WS_SPI_BIT_NS / 2) / WS_SPI_BIT_NS < 1 ? 1 : \
+	 ((ns) + WS_SPI_BIT_NS / 2) / WS_SPI_BIT_NS > 7 ? 7 : \
+	 ((ns) + WS_SPI_BIT_NS / 2) / WS_SPI_BIT_NS)
+
+/** SPI byte with n leading ones */
+#define WS_SPI_PATTERN(n) ((uint8_t)(0xFF << (8 - (n))))
+
+/** Encoded '0' and '1' */
+#define WS_SPI_0 WS_SPI_PATTERN(WS_SPI_BITS(WS_T0H_NS))
+#define WS_SPI_1 WS_SPI_PATTERN(WS_SPI_BITS(WS_T1H_NS))
+
+/** Resulting pulse widths, ns */
+#define WS_T0H_REAL (WS_SPI_BITS(WS_T0H_NS) * WS_SPI_BIT_NS)
+#define WS_T1H_REAL (WS_SPI_BITS(WS_T1H_NS) * WS_SPI_BIT_NS)
+
+
+/** Send one byte to the RGB strip */
+static void ws_send_byte(uint8_t bb)
+{
+	for (int8_t i = 8; i > 0; i--) {
+		spi_send((bb & 0x80) ? WS_SPI_1 : WS_SPI_0);
+		bb = (uint8_t)(bb << 1);
+	}
+}
+
+
+/** Init the SPI master */
+void ws_init(void)
+{
+	spi_init_master(SPI_MSB_FIRST, CPOL_0, CPHA_0, SPI_DIV_2);
+
+	// idle low
+	pin_down(PIN_MOSI);
+}
+
+
+/** Send a RGB color to the strip */
+void ws_send_rgb(uint8_t r, uint8_t g, uint8_t b)
+{
+	ws_send_byte(g);
+	ws_send_byte(r);
+	ws_send_byte(b);
+}
+
+#elif WS_BACKEND == WS_BACKEND_PARALLEL
+
+// Same as the bit-bang backend, but the port byte written at the falling
+// edge of a '0' comes from the slots - lanes sending a '0' go low there,
+// the others stay high until the '1' falling edge. The loop is in
+// ws2812_timing.h.
+
+#define WS_W1 WS_PAR_W1(F_CPU)
+#define WS_W2 WS_PAR_W2(F_CPU)
+#define WS_W3 WS_PAR_W3(F_CPU)
+
+/** Resulting pulse widths, ns */
+#define WS_T0H_REAL cycles2ns(WS_PAR_T0H(F_CPU))
+#define WS_T1H_REAL cycles2ns(WS_PAR_T1H(F_CPU))
+
+_Static_assert(WS_LANES >= 1 && WS_LANES <= 8, "WS_LANES must be 1..8");
+_Static_assert(WS_TIMING_OK(WS_PAR_T0H(F_CPU), WS_PAR_T1H(F_CPU), WS_PAR_TBIT(F_CPU), F_CPU),
+               "WS2812 low time or bit period out of spec at this F_CPU (the parallel backend needs 12 MHz or more)");
+
+
+/** Init the output pins */
+void ws_init(void)
+{
+	WS_PAR_PORT &= (uint8_t) ~WS_LANE_MASK;
+	WS_PAR_DDR |= WS_LANE_MASK;
+}
+
+
+/** Send one LED position to all strips */
+void ws_par_send(const uint8_t *slots)
+{
+	uint8_t cnt;
+	uint8_t d;
+
+	// An interrupt in the middle of a bit would corrupt it.
+	// It also must not change the port while we write it as a whole.
+	ATOMIC_BLOCK(ATOMIC_RESTORESTATE) {
+		uint8_t lo = WS_PAR_PORT & (uint8_t) ~WS_LANE_MASK;
+		uint8_t hi = lo | WS_LANE_MASK;
+
+		__asm__ volatile(
+			"	ldi  %[cnt], %[n]    \n"
+			"1:	ld   %[d], %a[p]+    \n"
+			"	or   %[d], %[lo]     \n"
+			"	out  %[port], %[hi]  \n"
+			"	.rept %[w1]          \n"
+			"	nop                  \n"
+			"	.endr                \n"
+			"	out  %[port], %[d]   \n"
+			"	.rept %[w2]          \n"
+			"	nop                  \n"
+			"	.endr                \n"
+			"	out  %[port], %[lo]  \n"
+			"	.rept %[w3]          \n"
+			"	nop                  \n"
+			"	.endr                \n"
+			"	dec  %[cnt]          \n"
+			"	brne 1b              \n"
+			: [cnt] "=&d" (cnt),
+			  [d] "=&r" (d),
+			  [p] "+e" (slots)
+			: [port] "I" (_SFR_IO_ADDR(WS_PAR_PORT)),
+			  [hi] "r" (hi),
+			  [lo] "r" (lo),
+			  [n] "M" (WS_SLOTS),
+			  [w1] "n" (WS_W1),
+			  [w2] "n" (WS_W2),
+			  [w3] "n" (WS_W3)
+			: "memory"
+		);
+	}
+}
+
+
+/** Send a RGB color to all strips */
+void ws_send_rgb(uint8_t r, uint8_t g, uint8_t b)
+{
+	uint8_t slots[WS_SLOTS];
+
+	memset(slots, 0, sizeof(slots));
+	ws_par_byte(slots, g, WS_LANE_MASK);
+	ws_par_byte(slots + 8, r, WS_LANE_MASK);
+	ws_par_byte(slots + 16, b, WS_LANE_MASK);
+
+	ws_par_send(slots);
+}
+
+#else
+#error "Unknown WS_BACKEND"
+#endif
+
+// Check the pulse widths against the WS2812B datasheet (+- 150 ns)
+_Static_assert(WS_T0H_REAL >= WS_T0H_NS - 150 && WS_T0H_REAL <= WS_T0H_NS + 150, "WS2812 T0H out of spec at this F_CPU");
+_Static_assert(WS_T1H_REAL >= WS_T1H_NS - 150 && WS_T1H_REAL <= WS_T1H_NS + 150, "WS2812 T1H out of spec at this F_CPU");
+
+
+#if WS_BACKEND != WS_BACKEND_SPI
+/** Interrupt state before ws_begin() */
+static uint8_t ws_sreg;
+#endif
+
+
+/** Start sending a frame */
+void ws_begin(void)
+{
+#if WS_BACKEND != WS_BACKEND_SPI
+	// an interrupt between two LEDs could latch the frame half-way
+	ws_sreg = SREG;
+	cli();
+#endif
+}
+
+
+/** End the frame, wait long enough for the colors to show */
+void ws_show(void)
+{
+#if WS_BACKEND != WS_BACKEND_SPI
+	SREG = ws_sreg;
+#endif
+
+	_delay_us(10);
+}
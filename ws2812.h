@@ -0,0 +1,112 @@
+#pragma once
+
+//
+//  WS2812 / WS2812B LED strip driver.
+//
+//  The backend is selected at build time with WS_BACKEND (see Makefile):
+//
+//  - WS_BACKEND_BITBANG - the waveform is generated by the CPU on WS_PIN.
+//    Interrupts are disabled for the whole frame, see below.
+//
+//  - WS_BACKEND_SPI - each data bit is encoded as one SPI byte and shifted
+//    out on MOSI (D11) by the SPI master at F_CPU/2, so the pulse widths
+//    come from the peripheral clock. D10 (SS) and D13 (SCK) are taken too.
+//    Interrupts stay enabled, they can only stretch the low time between
+//    bits. The LEDs tolerate that up to the reset time (50 us) - an
+//    interrupt handler taking longer would show half a frame.
+//
+//  - WS_BACKEND_PARALLEL - up to 8 strips driven at once, strip i on bit i
+//    of WS_PAR_PORT. The colors of one LED position on all strips are
+//    transposed into WS_SLOTS port bytes (one per data bit) with
+//    ws_par_set(), and ws_par_send() writes each byte to the whole port,
+//    so all strips get their LED in the time of one. Interrupts are
+//    disabled for the whole frame, as with the bit-bang. Only one LED
+//    position is transposed at a time, right before it's sent - the time
+//    that takes for WS_LANES colors is the pause between two positions,
+//    which has to stay under the reset time. Needs F_CPU of 12 MHz or more.
+//
+//  A frame is sent like this:
+//
+//    ws_begin();
+//    for (...) ws_send_rgb(r, g, b);
+//    ws_show();
+//
+//  With the CPU-timed backends, a pause of more than the reset time
+//  between two LEDs (an interrupt) would latch the frame half-way, so
+//  ws_begin() disables interrupts until ws_show(). That is about 30 us
+//  per LED (0.9 ms for 30 LEDs); edges coming meanwhile are handled late,
+//  and the systick runs the ms it missed afterwards. It can do that for
+//  up to SYSTICK_CATCHUP_MS (lib/systick.h), which strip.c checks the
+//  length of the strip against.
+//
+
+#include <avr/io.h>
+#include <stdint.h>
+
+#define WS_BACKEND_BITBANG 0
+#define WS_BACKEND_SPI 1
+#define WS_BACKEND_PARALLEL 2
+
+#ifndef WS_BACKEND
+#define WS_BACKEND WS_BACKEND_BITBANG
+#endif
+
+/** RGB data pin (bit-bang backend) */
+#define WS_PIN 7
+
+/** Init the output pin / peripheral */
+void ws_init(void);
+
+/** Start sending a frame (the CPU-timed backends disable interrupts until ws_show()) */
+void ws_begin(void);
+
+/** Send a RGB color to the strip (with the parallel backend, to all strips) */
+void ws_send_rgb(uint8_t r, uint8_t g, uint8_t b);
+
+/** End the frame, wait long enough for the colors to show */
+void ws_show(void);
+
+
+#if WS_BACKEND == WS_BACKEND_PARALLEL
+
+/** Output port (parallel backend). Default: PORTC, strips on A0.. */
+#ifndef WS_PAR_PORT
+#define WS_PAR_PORT PORTC
+#define WS_PAR_DDR  DDRC
+#endif
+
+/** Number of strips, 1..8 - they take bits 0..WS_LANES-1 of the port */
+#ifndef WS_LANES
+#define WS_LANES 6
+#endif
+
+#define WS_LANE_MASK ((uint8_t)((1U << WS_LANES) - 1))
+
+/** Port bytes per LED position (GRB, MSB first) */
+#define WS_SLOTS 24
+
+/** Set the bits of one byte on a lane */
+static inline void ws_par_byte(uint8_t *slots, uint8_t v, uint8_t lane_mask)
+{
+	for (uint8_t i = 0; i < 8; i++) {
+		if (v & 0x80) {
+			slots[i] |= lane_mask;
+		}
+		v = (uint8_t)(v << 1);
+	}
+}
+
+/** Put a lane's color into the slots of a LED position (the slots must start zeroed) */
+static inline void ws_par_set(uint8_t *slots, uint8_t lane, uint8_t r, uint8_t g, uint8_t b)
+{
+	uint8_t m = (uint8_t)(1 << lane);
+
+	ws_par_byte(slots, g, m);
+	ws_par_byte(slots + 8, r, m);
+	ws_par_byte(slots + 16, b, m);
+}
+
+/** Send one LED position (WS_SLOTS bytes) to all strips */
+void ws_par_send(const uint8_t *slots);
+
+#endif
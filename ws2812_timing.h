@@ -0,0 +1,89 @@
+#pragma once
+
+//
+//  WS2812 bit timing of the CPU-timed backends (ws2812.c).
+//
+//  The nop counts of the bit loops are computed here from the CPU
+//  frequency f, together with the pulse widths they result in. The
+//  driver uses them with F_CPU; host/test_ws_timing.c checks them
+//  against a cycle-by-cycle model of the loops for several frequencies.
+//
+//  The parallel loop spends 9 cycles on its instructions alone - at
+//  8 MHz, the low time after a '1' is then too long (875 ns), so that
+//  backend needs at least 12 MHz.
+//
+
+/** WS2812B timing (datasheet), ns */
+#define WS_T0H_NS 400
+#define WS_T1H_NS 800
+#define WS_T0L_NS 850
+#define WS_T1L_NS 450
+#define WS_TBIT_NS 1250
+
+/** Allowed deviation of the pulses, and of the bit period, ns */
+#define WS_TOL_NS 150
+#define WS_TBIT_TOL_NS 600
+
+/** Cycles of a time at f Hz, rounded to nearest */
+#define WS_CYCLES(ns, f) (((ns) * (long long)(f) + 500000000LL) / 1000000000LL)
+
+/** Time of a number of cycles at f Hz, ns (rounded down) */
+#define WS_NS(c, f) ((c) * 1000000000LL / (long long)(f))
+
+/** Clamp a delay to >= 0 cycles */
+#define WS_DELAY(c) ((c) > 0 ? (c) : 0)
+
+// Bit-bang backend, one bit:
+//
+//   cycle         instruction
+//   0             out  port, hi     rising edge
+//   1             w1 x nop
+//   1 + w1        sbrs b, 7         (skips the next out for a '1')
+//   2 + w1        out  port, lo     falling edge of a '0'
+//   3 + w1        lsl  b
+//   4 + w1        w2 x nop
+//   4 + w1 + w2   out  port, lo     falling edge of a '1'
+//   5 + w1 + w2   w3 x nop, dec, brne
+//
+//   period = 8 + w1 + w2 + w3
+
+#define WS_BB_W1(f) WS_DELAY(WS_CYCLES(WS_T0H_NS, f) - 2)
+#define WS_BB_W2(f) WS_DELAY(WS_CYCLES(WS_T1H_NS, f) - 4 - WS_BB_W1(f))
+#define WS_BB_W3(f) WS_DELAY(WS_CYCLES(WS_TBIT_NS, f) - 8 - WS_BB_W1(f) - WS_BB_W2(f))
+
+/** Resulting high time of a '0' and '1', and the bit period, cycles */
+#define WS_BB_T0H(f) (2 + WS_BB_W1(f))
+#define WS_BB_T1H(f) (4 + WS_BB_W1(f) + WS_BB_W2(f))
+#define WS_BB_TBIT(f) (8 + WS_BB_W1(f) + WS_BB_W2(f) + WS_BB_W3(f))
+
+// Parallel backend, one bit (see ws2812.c):
+//
+//   cycle         instruction
+//   0             ld   d, p+        data for all lanes
+//   2             or   d, lo
+//   3             out  port, hi     rising edge (all lanes)
+//   4             w1 x nop
+//   4 + w1        out  port, d      falling edge of the '0' lanes
+//   5 + w1        w2 x nop
+//   5 + w1 + w2   out  port, lo     falling edge of the '1' lanes
+//   6 + w1 + w2   w3 x nop, dec, brne
+//
+//   period = 9 + w1 + w2 + w3
+
+#define WS_PAR_W1(f) WS_DELAY(WS_CYCLES(WS_T0H_NS, f) - 1)
+#define WS_PAR_W2(f) WS_DELAY(WS_CYCLES(WS_T1H_NS, f) - 2 - WS_PAR_W1(f))
+#define WS_PAR_W3(f) WS_DELAY(WS_CYCLES(WS_TBIT_NS, f) - 9 - WS_PAR_W1(f) - WS_PAR_W2(f))
+
+/** Resulting high time of a '0' and '1', and the bit period, cycles */
+#define WS_PAR_T0H(f) (1 + WS_PAR_W1(f))
+#define WS_PAR_T1H(f) (2 + WS_PAR_W1(f) + WS_PAR_W2(f))
+#define WS_PAR_TBIT(f) (9 + WS_PAR_W1(f) + WS_PAR_W2(f) + WS_PAR_W3(f))
+
+/** Check that a pulse width (cycles at f Hz) is within the tolerance */
+#define WS_IN_SPEC(c, f, ns, tol) (WS_NS(c, f) >= (ns) - (tol) && WS_NS(c, f) <= (ns) + (tol))
+
+/** Check all pulses of a bit loop */
+#define WS_TIMING_OK(t0h, t1h, tbit, f) \
+	(WS_IN_SPEC(t0h, f, WS_T0H_NS, WS_TOL_NS) && WS_IN_SPEC(t1h, f, WS_T1H_NS, WS_TOL_NS) && \
+	 WS_IN_SPEC((tbit) - (t0h), f, WS_T0L_NS, WS_TOL_NS) && WS_IN_SPEC((tbit) - (t1h), f, WS_T1L_NS, WS_TOL_NS) && \
+	 WS_IN_SPEC(tbit, f, WS_TBIT_NS, WS_TBIT_TOL_NS))